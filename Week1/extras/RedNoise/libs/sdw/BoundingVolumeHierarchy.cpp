@@ -0,0 +1,649 @@
+#include "BoundingVolumeHierarchy.h"
+#include "PolygonData.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+	const int BIN_COUNT = 16;
+	const int MAX_LEAF_SIZE = 8;
+	// deepest a leaf may sit below the root. nodes that could not reach it by SAH splits are split at the median
+	const int MAX_DEPTH = 40;
+	// every binary node visited pushes at most one more child than it pops
+	const int MAX_STACK_SIZE = 64;
+	// and every wide node up to three more, which the wide tree can do at most once per level of the binary one
+	const int MAX_WIDE_STACK_SIZE = 128;
+	static_assert(MAX_STACK_SIZE >= MAX_DEPTH + 1, "binary traversal stack cannot hold the deepest tree");
+	static_assert(MAX_WIDE_STACK_SIZE >= 3 * MAX_DEPTH + 1, "wide traversal stack cannot hold the deepest tree");
+	const float TRAVERSAL_COST = 1.0f;
+	const float INTERSECTION_COST = 1.0f;
+
+	struct Bin {
+		glm::vec3 boundsMin = glm::vec3(std::numeric_limits<float>::max());
+		glm::vec3 boundsMax = glm::vec3(-std::numeric_limits<float>::max());
+		int count = 0;
+	};
+
+	struct StackEntry {
+		int nodeIndex;
+		float entryDistance;
+	};
+
+	struct WideStackEntry {
+		int child;
+		int triangleCount;
+		int packet;
+		float entryDistance;
+	};
+
+	// sorts the hit children furthest first and pushes them, so that the nearest is popped next
+	void pushNearestFirst(WideStackEntry* hitChildren, int hitCount, WideStackEntry* stack, int& stackSize) {
+		for (int i = 1; i < hitCount; i++) {
+			WideStackEntry entry = hitChildren[i];
+			int slot = i;
+			while (slot > 0 && hitChildren[slot - 1].entryDistance < entry.entryDistance) {
+				hitChildren[slot] = hitChildren[slot - 1];
+				slot--;
+			}
+			hitChildren[slot] = entry;
+		}
+		for (int i = 0; i < hitCount; i++) stack[stackSize++] = hitChildren[i];
+	}
+
+	void pushWideChildren(const WideBVHNode& node, int childMask, const float* entries, WideStackEntry* stack, int& stackSize) {
+		WideStackEntry hitChildren[WIDE_NODE_WIDTH];
+		int hitCount = 0;
+		for (int child = 0; child < node.childCount; child++) {
+			if (!(childMask & (1 << child))) continue;
+			hitChildren[hitCount++] = { node.child[child], node.triangleCount[child], node.packet[child], entries[child] };
+		}
+		pushNearestFirst(hitChildren, hitCount, stack, stackSize);
+	}
+
+	void pushQuantizedChildren(const QuantizedBVHNode& node, int childMask, const float* entries, const std::vector<int>& packetFirst,
+		WideStackEntry* stack, int& stackSize) {
+		WideStackEntry hitChildren[WIDE_NODE_WIDTH];
+		int hitCount = 0;
+		for (int child = 0; child < node.childCount; child++) {
+			if (!(childMask & (1 << child))) continue;
+			if (node.triangleCount[child] > 0) {
+				hitChildren[hitCount++] = { packetFirst[node.child[child]], node.triangleCount[child], node.child[child], entries[child] };
+			}
+			else hitChildren[hitCount++] = { node.child[child], 0, -1, entries[child] };
+		}
+		pushNearestFirst(hitChildren, hitCount, stack, stackSize);
+	}
+
+	// picks the smallest power of two step that spans the extent in 255 steps from origin, and rounds the
+	// child bounds outwards onto it. the exponent is stored as an int8_t, so 127 is the widest step there is. any
+	// finite extent fits well inside it; a non-finite one gets that step and the whole range, so rays always descend
+	void quantizeAxis(float origin, float extent, const float* childMin, const float* childMax, int childCount,
+		int8_t& exponent, uint8_t* quantizedMin, uint8_t* quantizedMax) {
+		const int WIDEST_STEP = 127;
+		bool finite = std::isfinite(origin) && std::isfinite(extent);
+		int step = finite && extent > 0 ? int(std::ceil(std::log2(extent / 255.0f))) : -100;
+		bool fits = false;
+		for (step = glm::clamp(step, -100, WIDEST_STEP); finite && step <= WIDEST_STEP; step++) {
+			float scale = quantizedScale(int8_t(step));
+			fits = true;
+			for (int child = 0; child < childCount && fits; child++) {
+				int low = glm::clamp(int(std::floor((childMin[child] - origin) / scale)), 0, 255);
+				while (low > 0 && origin + low * scale > childMin[child]) low--;
+				int high = glm::clamp(int(std::ceil((childMax[child] - origin) / scale)), 0, 255);
+				while (high < 255 && origin + high * scale < childMax[child]) high++;
+				fits = origin + low * scale <= childMin[child] && origin + high * scale >= childMax[child];
+				quantizedMin[child] = uint8_t(low);
+				quantizedMax[child] = uint8_t(high);
+			}
+			if (fits) break;
+		}
+		if (!fits) {
+			step = WIDEST_STEP;
+			std::fill(quantizedMin, quantizedMin + childCount, uint8_t(0));
+			std::fill(quantizedMax, quantizedMax + childCount, uint8_t(255));
+		}
+		exponent = int8_t(step);
+	}
+
+	// levels of halving it takes to get count primitives down to leaves
+	int medianLevels(int count) {
+		int levels = 0;
+		for (; count > MAX_LEAF_SIZE; levels++) count = (count + 1) / 2;
+		return levels;
+	}
+
+	float surfaceArea(const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+		glm::vec3 extent = glm::max(boundsMax - boundsMin, glm::vec3(0.0f));
+		return 2.0f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+	}
+
+	void fitBounds(BVHNode& node, const std::vector<int>& primitiveIndices, const std::vector<std::pair<glm::vec3, glm::vec3>>& primitiveBounds) {
+		node.boundsMin = glm::vec3(std::numeric_limits<float>::max());
+		node.boundsMax = glm::vec3(-std::numeric_limits<float>::max());
+		for (int i = node.leftFirst; i < node.leftFirst + node.triangleCount; i++) {
+			const std::pair<glm::vec3, glm::vec3>& bounds = primitiveBounds[primitiveIndices[i]];
+			node.boundsMin = glm::min(node.boundsMin, bounds.first);
+			node.boundsMax = glm::max(node.boundsMax, bounds.second);
+		}
+	}
+}
+
+BoundingVolumeHierarchy::BoundingVolumeHierarchy() : builtCost(0) {}
+
+void BoundingVolumeHierarchy::build(const std::vector<std::pair<glm::vec3, glm::vec3>>& primitiveBounds, const std::vector<int>& primitives) {
+	nodes.clear();
+	builtCost = 0;
+	primitiveIndices = primitives;
+	if (primitiveIndices.empty()) return;
+
+	std::vector<glm::vec3> centroids(primitiveBounds.size());
+	for (int primitive : primitiveIndices) {
+		centroids[primitive] = (primitiveBounds[primitive].first + primitiveBounds[primitive].second) * 0.5f;
+	}
+
+	// a binary tree over N primitives never needs more than 2N - 1 nodes
+	nodes.reserve(2 * primitiveIndices.size() - 1);
+	BVHNode root;
+	root.leftFirst = 0;
+	root.triangleCount = primitiveIndices.size();
+	fitBounds(root, primitiveIndices, primitiveBounds);
+	nodes.push_back(root);
+	subdivide(0, primitiveBounds, centroids);
+	builtCost = surfaceAreaCost();
+}
+
+void BoundingVolumeHierarchy::refit(const std::vector<std::pair<glm::vec3, glm::vec3>>& primitiveBounds) {
+	// children are always stored after their parent, so a reverse sweep visits them first
+	for (int nodeIndex = int(nodes.size()) - 1; nodeIndex >= 0; nodeIndex--) {
+		BVHNode& node = nodes[nodeIndex];
+		if (node.triangleCount > 0) {
+			fitBounds(node, primitiveIndices, primitiveBounds);
+			continue;
+		}
+		const BVHNode& left = nodes[node.leftFirst];
+		const BVHNode& right = nodes[node.leftFirst + 1];
+		node.boundsMin = glm::min(left.boundsMin, right.boundsMin);
+		node.boundsMax = glm::max(left.boundsMax, right.boundsMax);
+	}
+}
+
+float BoundingVolumeHierarchy::surfaceAreaCost() const {
+	if (nodes.empty()) return 0;
+	float cost = 0;
+	for (const BVHNode& node : nodes) {
+		float area = surfaceArea(node.boundsMin, node.boundsMax);
+		cost += area * (node.triangleCount > 0 ? node.triangleCount * INTERSECTION_COST : TRAVERSAL_COST);
+	}
+	float rootArea = surfaceArea(nodes[0].boundsMin, nodes[0].boundsMax);
+	return rootArea > 0 ? cost / rootArea : cost;
+}
+
+void BoundingVolumeHierarchy::updateTriangleRecords(PolygonData& objects) {
+	records.resize(primitiveIndices.size());
+	for (int i = 0; i < int(primitiveIndices.size()); i++) {
+		int triangleIndex = primitiveIndices[i];
+		TriangleRecord& record = records[i];
+		record.v0 = objects.getTriangleVertexPosition(triangleIndex, 0);
+		record.triangleIndex = triangleIndex;
+		record.e0 = objects.getTriangleVertexPosition(triangleIndex, 1) - record.v0;
+		record.e1 = objects.getTriangleVertexPosition(triangleIndex, 2) - record.v0;
+	}
+
+	packets.clear();
+	leafPackets.assign(nodes.size(), -1);
+	for (int nodeIndex = 0; nodeIndex < int(nodes.size()); nodeIndex++) {
+		const BVHNode& node = nodes[nodeIndex];
+		if (node.triangleCount == 0) continue;
+		// leaves never hold more than MAX_LEAF_SIZE triangles, which matches the packet width
+		leafPackets[nodeIndex] = packets.size();
+		packets.emplace_back();
+		fillTrianglePacket(packets.back(), &records[node.leftFirst], node.triangleCount);
+	}
+
+	wideNodes.clear();
+	if (!nodes.empty()) collapseWideNode(0);
+	quantizeWideNodes();
+}
+
+void BoundingVolumeHierarchy::quantizeWideNodes() {
+	packetFirst.assign(packets.size(), 0);
+	for (int nodeIndex = 0; nodeIndex < int(nodes.size()); nodeIndex++) {
+		if (leafPackets[nodeIndex] != -1) packetFirst[leafPackets[nodeIndex]] = nodes[nodeIndex].leftFirst;
+	}
+
+	quantizedNodes.assign(wideNodes.size(), QuantizedBVHNode());
+	for (int wideIndex = 0; wideIndex < int(wideNodes.size()); wideIndex++) {
+		const WideBVHNode& wide = wideNodes[wideIndex];
+		QuantizedBVHNode& quantized = quantizedNodes[wideIndex];
+		// the frame is the union of the children, which the parent's own box may be looser than after a refit
+		glm::vec3 frameMin(std::numeric_limits<float>::max());
+		glm::vec3 frameMax(-std::numeric_limits<float>::max());
+		for (int child = 0; child < wide.childCount; child++) {
+			frameMin = glm::min(frameMin, glm::vec3(wide.boundsMinX[child], wide.boundsMinY[child], wide.boundsMinZ[child]));
+			frameMax = glm::max(frameMax, glm::vec3(wide.boundsMaxX[child], wide.boundsMaxY[child], wide.boundsMaxZ[child]));
+		}
+		quantized.origin = frameMin;
+		quantizeAxis(frameMin.x, frameMax.x - frameMin.x, wide.boundsMinX, wide.boundsMaxX, wide.childCount,
+			quantized.exponent[0], quantized.boundsMinX, quantized.boundsMaxX);
+		quantizeAxis(frameMin.y, frameMax.y - frameMin.y, wide.boundsMinY, wide.boundsMaxY, wide.childCount,
+			quantized.exponent[1], quantized.boundsMinY, quantized.boundsMaxY);
+		quantizeAxis(frameMin.z, frameMax.z - frameMin.z, wide.boundsMinZ, wide.boundsMaxZ, wide.childCount,
+			quantized.exponent[2], quantized.boundsMinZ, quantized.boundsMaxZ);
+		quantized.childCount = uint8_t(wide.childCount);
+		for (int child = 0; child < WIDE_NODE_WIDTH; child++) {
+			bool leaf = child < wide.childCount && wide.triangleCount[child] > 0;
+			quantized.child[child] = leaf ? wide.packet[child] : wide.child[child];
+			quantized.triangleCount[child] = uint8_t(leaf ? wide.triangleCount[child] : 0);
+		}
+	}
+}
+
+size_t BoundingVolumeHierarchy::nodeMemory(BVHLayout layout) const {
+	if (layout == WIDE_LAYOUT) return wideNodes.size() * sizeof(WideBVHNode);
+	if (layout == QUANTIZED_LAYOUT) return quantizedNodes.size() * sizeof(QuantizedBVHNode) + packetFirst.size() * sizeof(int);
+	return nodes.size() * sizeof(BVHNode);
+}
+
+int BoundingVolumeHierarchy::collapseWideNode(int nodeIndex) {
+	// keep opening the interior child with the largest surface area until the wide node is full
+	int children[WIDE_NODE_WIDTH] = { nodeIndex };
+	int childCount = 1;
+	while (childCount < WIDE_NODE_WIDTH) {
+		int opened = -1;
+		float openedArea = -1;
+		for (int i = 0; i < childCount; i++) {
+			const BVHNode& child = nodes[children[i]];
+			if (child.triangleCount > 0) continue;
+			float area = surfaceArea(child.boundsMin, child.boundsMax);
+			if (area > openedArea) {
+				opened = i;
+				openedArea = area;
+			}
+		}
+		if (opened == -1) break;
+		int leftChild = nodes[children[opened]].leftFirst;
+		children[opened] = leftChild;
+		children[childCount++] = leftChild + 1;
+	}
+
+	int wideIndex = wideNodes.size();
+	wideNodes.emplace_back();
+	for (int i = 0; i < childCount; i++) {
+		const BVHNode& child = nodes[children[i]];
+		// recursing grows wideNodes, so the node is looked up again every time
+		int wideChild = child.triangleCount > 0 ? child.leftFirst : collapseWideNode(children[i]);
+		WideBVHNode& wide = wideNodes[wideIndex];
+		wide.boundsMinX[i] = child.boundsMin.x;
+		wide.boundsMinY[i] = child.boundsMin.y;
+		wide.boundsMinZ[i] = child.boundsMin.z;
+		wide.boundsMaxX[i] = child.boundsMax.x;
+		wide.boundsMaxY[i] = child.boundsMax.y;
+		wide.boundsMaxZ[i] = child.boundsMax.z;
+		wide.child[i] = wideChild;
+		wide.triangleCount[i] = child.triangleCount;
+		wide.packet[i] = leafPackets[children[i]];
+	}
+	WideBVHNode& wide = wideNodes[wideIndex];
+	for (int i = childCount; i < WIDE_NODE_WIDTH; i++) {
+		wide.boundsMinX[i] = wide.boundsMinY[i] = wide.boundsMinZ[i] = 0;
+		wide.boundsMaxX[i] = wide.boundsMaxY[i] = wide.boundsMaxZ[i] = 0;
+		wide.child[i] = -1;
+		wide.triangleCount[i] = 0;
+		wide.packet[i] = -1;
+	}
+	wide.childCount = childCount;
+	return wideIndex;
+}
+
+bool BoundingVolumeHierarchy::intersectLeaf(int first, int count, int packet, const glm::vec3& origin, const glm::vec3& direction,
+	int excludeID, float& closest, BVHHit& hit) const {
+	if (activeTriangleKernel == SCALAR_KERNEL) return intersectTriangleRecords(&records[first], count, origin, direction, excludeID, closest, hit);
+	return intersectTrianglePacket(packets[packet], origin, direction, excludeID, closest, hit);
+}
+
+bool BoundingVolumeHierarchy::occludedLeaf(int first, int count, int packet, const glm::vec3& origin, const glm::vec3& direction,
+	int excludeID, float maxDistance) const {
+	if (activeTriangleKernel == SCALAR_KERNEL) return occludedTriangleRecords(&records[first], count, origin, direction, excludeID, maxDistance);
+	return occludedTrianglePacket(packets[packet], origin, direction, excludeID, maxDistance);
+}
+
+float BoundingVolumeHierarchy::slabEntry(const BVHNode& node, const glm::vec3& origin, const glm::vec3& invertedDirection, float maxDistance) {
+	glm::vec3 rayMin = (node.boundsMin - origin) * invertedDirection;
+	glm::vec3 rayMax = (node.boundsMax - origin) * invertedDirection;
+	glm::vec3 nearest = glm::min(rayMin, rayMax);
+	glm::vec3 furthest = glm::max(rayMin, rayMax);
+	float finalEntry = glm::max(nearest.x, nearest.y, nearest.z);
+	float finalExit = glm::min(furthest.x, furthest.y, furthest.z);
+	if (finalExit < finalEntry || finalExit < 0 || finalEntry > maxDistance) return std::numeric_limits<float>::infinity();
+	return finalEntry;
+}
+
+float BoundingVolumeHierarchy::packetEntry(const BVHNode& node, const RayPacket& packet, float maxDistance) {
+	float finalEntry = -std::numeric_limits<float>::max();
+	float finalExit = std::numeric_limits<float>::max();
+	for (int axis = 0; axis < 3; axis++) {
+		// the packet agrees on the sign of each axis, so every ray enters through the same plane
+		bool negative = std::signbit(packet.inverseMin[axis]);
+		float entryPlane = (negative ? node.boundsMax[axis] : node.boundsMin[axis]) - packet.origin[axis];
+		float exitPlane = (negative ? node.boundsMin[axis] : node.boundsMax[axis]) - packet.origin[axis];
+		float entry = glm::min(entryPlane * packet.inverseMin[axis], entryPlane * packet.inverseMax[axis]);
+		float exit = glm::max(exitPlane * packet.inverseMin[axis], exitPlane * packet.inverseMax[axis]);
+		finalEntry = glm::max(finalEntry, entry);
+		finalExit = glm::min(finalExit, exit);
+	}
+	if (finalExit < finalEntry || finalExit < 0 || finalEntry > maxDistance) return std::numeric_limits<float>::infinity();
+	return finalEntry;
+}
+
+void BoundingVolumeHierarchy::subdivide(int rootIndex, const std::vector<std::pair<glm::vec3, glm::vec3>>& primitiveBounds, std::vector<glm::vec3>& centroids) {
+	// nodes still to split and their depth, worked through with an explicit stack so deep trees cannot overflow the call stack
+	std::vector<std::pair<int, int>> pending = { { rootIndex, 0 } };
+	while (!pending.empty()) {
+		int nodeIndex = pending.back().first;
+		int depth = pending.back().second;
+		pending.pop_back();
+		// copied out, since growing the node list invalidates references into it
+		int first = nodes[nodeIndex].leftFirst;
+		int count = nodes[nodeIndex].triangleCount;
+
+		glm::vec3 centroidMin(std::numeric_limits<float>::max());
+		glm::vec3 centroidMax(-std::numeric_limits<float>::max());
+		for (int i = first; i < first + count; i++) {
+			centroidMin = glm::min(centroidMin, centroids[primitiveIndices[i]]);
+			centroidMax = glm::max(centroidMax, centroids[primitiveIndices[i]]);
+		}
+
+		// bin the centroids along each axis and sweep the bin boundaries for the cheapest split
+		float parentArea = surfaceArea(nodes[nodeIndex].boundsMin, nodes[nodeIndex].boundsMax);
+		if (parentArea <= 0) parentArea = 1;
+		float leafCost = count * INTERSECTION_COST;
+		float bestCost = std::numeric_limits<float>::max();
+		int bestAxis = -1;
+		int bestSplit = 0;
+		for (int axis = 0; axis < 3; axis++) {
+			float extent = centroidMax[axis] - centroidMin[axis];
+			if (extent <= 0) continue;
+			float binScale = BIN_COUNT / extent;
+
+			Bin bins[BIN_COUNT];
+			for (int i = first; i < first + count; i++) {
+				int primitive = primitiveIndices[i];
+				int binIndex = glm::min(BIN_COUNT - 1, int((centroids[primitive][axis] - centroidMin[axis]) * binScale));
+				bins[binIndex].count++;
+				bins[binIndex].boundsMin = glm::min(bins[binIndex].boundsMin, primitiveBounds[primitive].first);
+				bins[binIndex].boundsMax = glm::max(bins[binIndex].boundsMax, primitiveBounds[primitive].second);
+			}
+
+			float leftArea[BIN_COUNT - 1];
+			int leftCount[BIN_COUNT - 1];
+			Bin leftSweep;
+			for (int split = 0; split < BIN_COUNT - 1; split++) {
+				leftSweep.count += bins[split].count;
+				leftSweep.boundsMin = glm::min(leftSweep.boundsMin, bins[split].boundsMin);
+				leftSweep.boundsMax = glm::max(leftSweep.boundsMax, bins[split].boundsMax);
+				leftCount[split] = leftSweep.count;
+				leftArea[split] = surfaceArea(leftSweep.boundsMin, leftSweep.boundsMax);
+			}
+			Bin rightSweep;
+			for (int split = BIN_COUNT - 2; split >= 0; split--) {
+				rightSweep.count += bins[split + 1].count;
+				rightSweep.boundsMin = glm::min(rightSweep.boundsMin, bins[split + 1].boundsMin);
+				rightSweep.boundsMax = glm::max(rightSweep.boundsMax, bins[split + 1].boundsMax);
+				if (leftCount[split] == 0 || rightSweep.count == 0) continue;
+				// a side too big to reach its leaves by halving within MAX_DEPTH rules the split out
+				if (depth + 1 + glm::max(medianLevels(leftCount[split]), medianLevels(rightSweep.count)) > MAX_DEPTH) continue;
+				float rightArea = surfaceArea(rightSweep.boundsMin, rightSweep.boundsMax);
+				float cost = TRAVERSAL_COST +
+					(leftArea[split] * leftCount[split] + rightArea * rightSweep.count) / parentArea * INTERSECTION_COST;
+				if (cost < bestCost) {
+					bestCost = cost;
+					bestAxis = axis;
+					bestSplit = split;
+				}
+			}
+		}
+
+		if (count <= MAX_LEAF_SIZE && (bestAxis == -1 || bestCost >= leafCost)) continue;
+
+		int middle = first + count / 2;
+		if (bestAxis != -1) {
+			float binScale = BIN_COUNT / (centroidMax[bestAxis] - centroidMin[bestAxis]);
+			int* partitioned = std::partition(primitiveIndices.data() + first, primitiveIndices.data() + first + count, [&](int primitive) {
+				int binIndex = glm::min(BIN_COUNT - 1, int((centroids[primitive][bestAxis] - centroidMin[bestAxis]) * binScale));
+				return binIndex <= bestSplit;
+			});
+			middle = int(partitioned - primitiveIndices.data());
+		}
+		else {
+			// no split fits the depth left, so the centroids are halved along their longest axis, which always does
+			glm::vec3 extent = centroidMax - centroidMin;
+			int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+			std::nth_element(primitiveIndices.data() + first, primitiveIndices.data() + middle, primitiveIndices.data() + first + count,
+				[&](int a, int b) { return centroids[a][axis] < centroids[b][axis]; });
+		}
+		// coincident centroids cannot be separated spatially, so oversized leaves are halved instead
+		if (middle == first || middle == first + count) middle = first + count / 2;
+
+		int leftChild = nodes.size();
+		BVHNode left;
+		left.leftFirst = first;
+		left.triangleCount = middle - first;
+		fitBounds(left, primitiveIndices, primitiveBounds);
+		BVHNode right;
+		right.leftFirst = middle;
+		right.triangleCount = first + count - middle;
+		fitBounds(right, primitiveIndices, primitiveBounds);
+		nodes.push_back(left);
+		nodes.push_back(right);
+
+		nodes[nodeIndex].leftFirst = leftChild;
+		nodes[nodeIndex].triangleCount = 0;
+		// the left child is popped first, which keeps the node order of the recursive build
+		pending.push_back({ leftChild + 1, depth + 1 });
+		pending.push_back({ leftChild, depth + 1 });
+	}
+}
+
+bool BoundingVolumeHierarchy::intersect(const glm::vec3& origin, const glm::vec3& direction, BVHHit& hit,
+	int excludeID, float maxDistance) const {
+	if (nodes.empty()) return false;
+	glm::vec3 invertedDirection = 1.0f / direction;
+	float closest = maxDistance;
+	bool found = false;
+
+	StackEntry stack[MAX_STACK_SIZE];
+	int stackSize = 0;
+	float rootEntry = slabEntry(nodes[0], origin, invertedDirection, closest);
+	if (rootEntry == std::numeric_limits<float>::infinity()) return false;
+	stack[stackSize++] = { 0, rootEntry };
+
+	while (stackSize > 0) {
+		StackEntry current = stack[--stackSize];
+		// a closer hit may have been found since this node was pushed
+		if (current.entryDistance > closest) continue;
+		const BVHNode& node = nodes[current.nodeIndex];
+
+		if (node.triangleCount > 0) {
+			if (intersectLeaf(node.leftFirst, node.triangleCount, leafPackets[current.nodeIndex], origin, direction, excludeID, closest, hit)) {
+				found = true;
+			}
+			continue;
+		}
+
+		// push the far child first so that the near child is popped next
+		float leftEntry = slabEntry(nodes[node.leftFirst], origin, invertedDirection, closest);
+		float rightEntry = slabEntry(nodes[node.leftFirst + 1], origin, invertedDirection, closest);
+		StackEntry nearChild = { node.leftFirst, leftEntry };
+		StackEntry farChild = { node.leftFirst + 1, rightEntry };
+		if (rightEntry < leftEntry) std::swap(nearChild, farChild);
+		if (farChild.entryDistance != std::numeric_limits<float>::infinity()) stack[stackSize++] = farChild;
+		if (nearChild.entryDistance != std::numeric_limits<float>::infinity()) stack[stackSize++] = nearChild;
+	}
+	return found;
+}
+
+bool BoundingVolumeHierarchy::intersectWide(const glm::vec3& origin, const glm::vec3& direction, BVHHit& hit,
+	int excludeID, float maxDistance) const {
+	if (wideNodes.empty()) return false;
+	glm::vec3 invertedDirection = 1.0f / direction;
+	float closest = maxDistance;
+	bool found = false;
+
+	WideStackEntry stack[MAX_WIDE_STACK_SIZE];
+	int stackSize = 0;
+	stack[stackSize++] = { 0, 0, -1, -std::numeric_limits<float>::max() };
+
+	while (stackSize > 0) {
+		WideStackEntry current = stack[--stackSize];
+		if (current.entryDistance > closest) continue;
+
+		if (current.triangleCount > 0) {
+			if (intersectLeaf(current.child, current.triangleCount, current.packet, origin, direction, excludeID, closest, hit)) found = true;
+			continue;
+		}
+
+		const WideBVHNode& node = wideNodes[current.child];
+		float entries[WIDE_NODE_WIDTH];
+		int childMask = intersectWideNodeBounds(node, origin, invertedDirection, closest, entries);
+		if (childMask != 0) pushWideChildren(node, childMask, entries, stack, stackSize);
+	}
+	return found;
+}
+
+bool BoundingVolumeHierarchy::intersectQuantized(const glm::vec3& origin, const glm::vec3& direction, BVHHit& hit,
+	int excludeID, float maxDistance) const {
+	if (quantizedNodes.empty()) return false;
+	glm::vec3 invertedDirection = 1.0f / direction;
+	float closest = maxDistance;
+	bool found = false;
+
+	WideStackEntry stack[MAX_WIDE_STACK_SIZE];
+	int stackSize = 0;
+	stack[stackSize++] = { 0, 0, -1, -std::numeric_limits<float>::max() };
+
+	while (stackSize > 0) {
+		WideStackEntry current = stack[--stackSize];
+		if (current.entryDistance > closest) continue;
+
+		if (current.triangleCount > 0) {
+			if (intersectLeaf(current.child, current.triangleCount, current.packet, origin, direction, excludeID, closest, hit)) found = true;
+			continue;
+		}
+
+		const QuantizedBVHNode& node = quantizedNodes[current.child];
+		float entries[WIDE_NODE_WIDTH];
+		int childMask = intersectQuantizedNodeBounds(node, origin, invertedDirection, closest, entries);
+		if (childMask != 0) pushQuantizedChildren(node, childMask, entries, packetFirst, stack, stackSize);
+	}
+	return found;
+}
+
+void BoundingVolumeHierarchy::intersectPacket(RayPacket& packet) const {
+	if (nodes.empty()) return;
+	// the packet only moves on while at least one of its rays could still find something closer
+	float furthest = 0;
+	for (int ray = 0; ray < packet.rayCount; ray++) furthest = glm::max(furthest, packet.closest[ray]);
+
+	StackEntry stack[MAX_STACK_SIZE];
+	int stackSize = 0;
+	float rootEntry = packetEntry(nodes[0], packet, furthest);
+	if (rootEntry == std::numeric_limits<float>::infinity()) return;
+	stack[stackSize++] = { 0, rootEntry };
+
+	while (stackSize > 0) {
+		StackEntry current = stack[--stackSize];
+		if (current.entryDistance > furthest) continue;
+		const BVHNode& node = nodes[current.nodeIndex];
+
+		if (node.triangleCount > 0) {
+			for (int i = node.leftFirst; i < node.leftFirst + node.triangleCount; i++) {
+				intersectTriangleRays(records[i], packet);
+			}
+			furthest = 0;
+			for (int ray = 0; ray < packet.rayCount; ray++) furthest = glm::max(furthest, packet.closest[ray]);
+			continue;
+		}
+
+		float leftEntry = packetEntry(nodes[node.leftFirst], packet, furthest);
+		float rightEntry = packetEntry(nodes[node.leftFirst + 1], packet, furthest);
+		StackEntry nearChild = { node.leftFirst, leftEntry };
+		StackEntry farChild = { node.leftFirst + 1, rightEntry };
+		if (rightEntry < leftEntry) std::swap(nearChild, farChild);
+		if (farChild.entryDistance != std::numeric_limits<float>::infinity()) stack[stackSize++] = farChild;
+		if (nearChild.entryDistance != std::numeric_limits<float>::infinity()) stack[stackSize++] = nearChild;
+	}
+}
+
+bool BoundingVolumeHierarchy::occluded(const glm::vec3& origin, const glm::vec3& direction, int excludeID, float maxDistance) const {
+	if (nodes.empty()) return false;
+	glm::vec3 invertedDirection = 1.0f / direction;
+
+	int stack[MAX_STACK_SIZE];
+	int stackSize = 0;
+	if (slabEntry(nodes[0], origin, invertedDirection, maxDistance) == std::numeric_limits<float>::infinity()) return false;
+	stack[stackSize++] = 0;
+
+	while (stackSize > 0) {
+		int nodeIndex = stack[--stackSize];
+		const BVHNode& node = nodes[nodeIndex];
+
+		if (node.triangleCount > 0) {
+			if (occludedLeaf(node.leftFirst, node.triangleCount, leafPackets[nodeIndex], origin, direction, excludeID, maxDistance)) return true;
+			continue;
+		}
+
+		for (int child = node.leftFirst; child <= node.leftFirst + 1; child++) {
+			if (slabEntry(nodes[child], origin, invertedDirection, maxDistance) != std::numeric_limits<float>::infinity()) {
+				stack[stackSize++] = child;
+			}
+		}
+	}
+	return false;
+}
+
+bool BoundingVolumeHierarchy::occludedWide(const glm::vec3& origin, const glm::vec3& direction, int excludeID, float maxDistance) const {
+	if (wideNodes.empty()) return false;
+	glm::vec3 invertedDirection = 1.0f / direction;
+
+	WideStackEntry stack[MAX_WIDE_STACK_SIZE];
+	int stackSize = 0;
+	stack[stackSize++] = { 0, 0, -1, 0 };
+
+	while (stackSize > 0) {
+		WideStackEntry current = stack[--stackSize];
+
+		if (current.triangleCount > 0) {
+			if (occludedLeaf(current.child, current.triangleCount, current.packet, origin, direction, excludeID, maxDistance)) return true;
+			continue;
+		}
+
+		const WideBVHNode& node = wideNodes[current.child];
+		float entries[WIDE_NODE_WIDTH];
+		int childMask = intersectWideNodeBounds(node, origin, invertedDirection, maxDistance, entries);
+		if (childMask != 0) pushWideChildren(node, childMask, entries, stack, stackSize);
+	}
+	return false;
+}
+
+bool BoundingVolumeHierarchy::occludedQuantized(const glm::vec3& origin, const glm::vec3& direction, int excludeID, float maxDistance) const {
+	if (quantizedNodes.empty()) return false;
+	glm::vec3 invertedDirection = 1.0f / direction;
+
+	WideStackEntry stack[MAX_WIDE_STACK_SIZE];
+	int stackSize = 0;
+	stack[stackSize++] = { 0, 0, -1, 0 };
+
+	while (stackSize > 0) {
+		WideStackEntry current = stack[--stackSize];
+
+		if (current.triangleCount > 0) {
+			if (occludedLeaf(current.child, current.triangleCount, current.packet, origin, direction, excludeID, maxDistance)) return true;
+			continue;
+		}
+
+		const QuantizedBVHNode& node = quantizedNodes[current.child];
+		float entries[WIDE_NODE_WIDTH];
+		int childMask = intersectQuantizedNodeBounds(node, origin, invertedDirection, maxDistance, entries);
+		if (childMask != 0) pushQuantizedChildren(node, childMask, entries, packetFirst, stack, stackSize);
+	}
+	return false;
+}
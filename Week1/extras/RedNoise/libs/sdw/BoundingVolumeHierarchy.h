@@ -0,0 +1,92 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <vector>
+#include <utility>
+#include <limits>
+#include "TriangleKernels.h"
+
+struct PolygonData;
+
+// node formats the object trees can be traversed through, selectable so that they can be benchmarked against each other
+enum BVHLayout {
+	BINARY_LAYOUT,
+	WIDE_LAYOUT,
+	QUANTIZED_LAYOUT,
+};
+
+struct BVHNode {
+	glm::vec3 boundsMin;
+	int leftFirst; // left child for interior nodes (right child is leftFirst + 1), first slot for leaves
+	glm::vec3 boundsMax;
+	int triangleCount; // 0 for interior nodes
+};
+
+class BoundingVolumeHierarchy {
+private:
+	// splits the node and every node below it until the leaves are reached
+	void subdivide(int rootIndex, const std::vector<std::pair<glm::vec3, glm::vec3>>& primitiveBounds, std::vector<glm::vec3>& centroids);
+	int collapseWideNode(int nodeIndex);
+	void quantizeWideNodes();
+	bool intersectLeaf(int first, int count, int packet, const glm::vec3& origin, const glm::vec3& direction,
+		int excludeID, float& closest, BVHHit& hit) const;
+	bool occludedLeaf(int first, int count, int packet, const glm::vec3& origin, const glm::vec3& direction,
+		int excludeID, float maxDistance) const;
+
+public:
+	std::vector<BVHNode> nodes;
+	std::vector<int> primitiveIndices; // triangle indices for object trees, instance indices for the top level tree
+	std::vector<TriangleRecord> records; // parallel to primitiveIndices, only filled for trees of triangles
+	std::vector<TrianglePacket> packets; // one per leaf, read by the SIMD kernels
+	std::vector<int> leafPackets; // packet of every node, -1 for interior nodes
+	std::vector<WideBVHNode> wideNodes; // the same tree collapsed to 4 children per node, root first
+	std::vector<QuantizedBVHNode> quantizedNodes; // parallel to wideNodes
+	std::vector<int> packetFirst; // first record of every packet, as quantized leaves only keep their packet
+	float builtCost; // surfaceAreaCost straight after the last build
+
+	BoundingVolumeHierarchy();
+
+	// builds a binned surface area heuristic tree over the given primitives, bounds are indexed by primitive
+	void build(const std::vector<std::pair<glm::vec3, glm::vec3>>& primitiveBounds, const std::vector<int>& primitives);
+
+	// refits every node bottom-up to the new primitive bounds without changing the topology
+	void refit(const std::vector<std::pair<glm::vec3, glm::vec3>>& primitiveBounds);
+
+	// expected cost of a ray query relative to the root, used to detect trees degraded by refitting
+	float surfaceAreaCost() const;
+
+	// caches the intersection record of every triangle in leaf order, plus a packet of them for each leaf,
+	// and collapses the current node bounds into the wide and quantized trees
+	void updateTriangleRecords(PolygonData& objects);
+
+	// bytes taken by the nodes of the given layout, records and packets are shared by every layout
+	size_t nodeMemory(BVHLayout layout) const;
+
+	// returns how far along the ray the box is entered, or infinity when it is missed
+	static float slabEntry(const BVHNode& node, const glm::vec3& origin, const glm::vec3& invertedDirection, float maxDistance);
+
+	// conservative slab test of a coherent packet's frustum, returns the earliest entry of any ray
+	// or infinity when no ray of the packet can hit the box within maxDistance
+	static float packetEntry(const BVHNode& node, const RayPacket& packet, float maxDistance);
+
+	// front-to-back closest hit query over a tree of triangles. hit holds the best hit so far (triangleIndex -1 if none)
+	// and is only overwritten when true is returned
+	bool intersect(const glm::vec3& origin, const glm::vec3& direction, BVHHit& hit,
+		int excludeID = -1, float maxDistance = std::numeric_limits<float>::max()) const;
+
+	// intersect over the wide tree, visiting the children of each node nearest first
+	bool intersectWide(const glm::vec3& origin, const glm::vec3& direction, BVHHit& hit,
+		int excludeID = -1, float maxDistance = std::numeric_limits<float>::max()) const;
+
+	bool intersectQuantized(const glm::vec3& origin, const glm::vec3& direction, BVHHit& hit,
+		int excludeID = -1, float maxDistance = std::numeric_limits<float>::max()) const;
+
+	// closest hit query for every ray of a coherent packet, nodes are culled against the whole packet
+	void intersectPacket(RayPacket& packet) const;
+
+	// any-hit query for shadow rays, stops at the first triangle hit no further than maxDistance
+	bool occluded(const glm::vec3& origin, const glm::vec3& direction, int excludeID, float maxDistance) const;
+
+	bool occludedWide(const glm::vec3& origin, const glm::vec3& direction, int excludeID, float maxDistance) const;
+
+	bool occludedQuantized(const glm::vec3& origin, const glm::vec3& direction, int excludeID, float maxDistance) const;
+};
@@ -55,19 +55,28 @@ void DrawingWindow::savePPM(const std::string &filename) const {
 	outputStream.close();
 }
 
+void DrawingWindow::quitOnRequest(const SDL_Event &event) {
+	if ((event.type == SDL_QUIT) || ((event.type == SDL_KEYDOWN) && (event.key.keysym.sym == SDLK_ESCAPE))) {
+		SDL_DestroyTexture(texture);
+		SDL_DestroyRenderer(renderer);
+		SDL_DestroyWindow(window);
+		SDL_Quit();
+		printMessageAndQuit("Exiting", nullptr);
+	}
+}
+
 bool DrawingWindow::pollForInputEvents(SDL_Event &event) {
 	if (SDL_PollEvent(&event)) {
-		if ((event.type == SDL_QUIT) || ((event.type == SDL_KEYDOWN) && (event.key.keysym.sym == SDLK_ESCAPE))) {
-			SDL_DestroyTexture(texture);
-			SDL_DestroyRenderer(renderer);
-			SDL_DestroyWindow(window);
-			SDL_Quit();
-			printMessageAndQuit("Exiting", nullptr);
-		}
-		SDL_Event dummy;
-		// Clear the event queue by getting all available events
-		// This seems like bad practice (because it will skip some events) however preventing backlog is paramount !
-		while (SDL_PollEvent(&dummy));
+		quitOnRequest(event);
+		// events are returned one at a time, callers drain the queue every frame so none are lost
+		return true;
+	}
+	return false;
+}
+
+bool DrawingWindow::waitForInputEvents(SDL_Event &event, int timeoutMilliseconds) {
+	if (SDL_WaitEventTimeout(&event, timeoutMilliseconds)) {
+		quitOnRequest(event);
 		return true;
 	}
 	return false;
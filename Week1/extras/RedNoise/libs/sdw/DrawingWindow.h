@@ -17,6 +17,9 @@ private:
 	SDL_Texture *texture;
 	std::vector<uint32_t> pixelBuffer;
 
+	// closes the window and exits when event asks to quit
+	void quitOnRequest(const SDL_Event &event);
+
 public:
 	DrawingWindow();
 	DrawingWindow(int w, int h, bool fullscreen);
@@ -24,6 +27,8 @@ public:
 	void savePPM(const std::string &filename) const;
 	void saveBMP(const std::string &filename) const;
 	bool pollForInputEvents(SDL_Event &event);
+	// sleeps until an event arrives or the timeout passes, returns whether event was filled in
+	bool waitForInputEvents(SDL_Event &event, int timeoutMilliseconds);
 	void setPixelColour(size_t x, size_t y, uint32_t colour);
 	uint32_t getPixelColour(size_t x, size_t y);
 	void clearPixels();
@@ -1,4 +1,5 @@
 #include "PolygonData.h"
+#include <limits>
 
 PolygonData::PolygonData() = default;
 
@@ -25,3 +26,79 @@ std::array<glm::vec2, 3> PolygonData::getTextureVertices(int triangleIndex) {
 	}
 	return textureVertices;
 }
+
+void PolygonData::computeTriangleGeometry() {
+	glm::vec3 sceneMin(std::numeric_limits<float>::max());
+	glm::vec3 sceneMax(-std::numeric_limits<float>::max());
+	for (int triangleIndex = 0; triangleIndex < int(this->loadedTriangles.size()); triangleIndex++) {
+		this->updateTriangleGeometry(triangleIndex);
+		sceneMax = glm::max(sceneMax, this->loadedTriangles[triangleIndex].boundingMinMax.second);
+		sceneMin = glm::min(sceneMin, this->loadedTriangles[triangleIndex].boundingMinMax.first);
+	}
+	this->sceneBoundingMinMax = { sceneMin, sceneMax };
+
+	// normalise all vertex normal sums.
+	for (auto& entry : this->vertexToTriangles) {
+		this->updateVertexNormal(entry.first);
+	}
+}
+
+void PolygonData::updateTriangleGeometry(int triangleIndex) {
+	glm::vec3 v0 = this->getTriangleVertexPosition(triangleIndex, 0);
+	glm::vec3 v1 = this->getTriangleVertexPosition(triangleIndex, 1);
+	glm::vec3 v2 = this->getTriangleVertexPosition(triangleIndex, 2);
+	// calculate normals
+	glm::vec3 e0 = v1 - v0;
+	glm::vec3 e1 = v2 - v0;
+	this->loadedTriangles[triangleIndex].normal = glm::normalize(glm::cross(e0, e1));
+
+	// calculate the bounding box for raytrace optimisation
+	glm::vec3 minBound = glm::min(v0, v1, v2);
+	glm::vec3 maxBound = glm::max(v0, v1, v2);
+	this->loadedTriangles[triangleIndex].boundingMinMax = { minBound, maxBound };
+}
+
+void PolygonData::updateVertexNormal(int vertexIndex) {
+	auto triangles = this->vertexToTriangles.find(vertexIndex);
+	if (triangles == this->vertexToTriangles.end()) return;
+	glm::vec3 vertexNormal = { 0,0,0 };
+	for (int triangleIndex : triangles->second) {
+		vertexNormal += this->loadedTriangles[triangleIndex].normal;
+	}
+	this->loadedVertices[vertexIndex].normal = glm::normalize(vertexNormal);
+}
+
+void PolygonData::updateVertexPositions(const std::vector<int>& vertexIndices, const std::vector<glm::vec3>& positions) {
+	std::set<int> movedTriangles;
+	for (int i = 0; i < int(vertexIndices.size()); i++) {
+		this->loadedVertices[vertexIndices[i]].position = positions[i];
+		auto triangles = this->vertexToTriangles.find(vertexIndices[i]);
+		if (triangles != this->vertexToTriangles.end()) movedTriangles.insert(triangles->second.begin(), triangles->second.end());
+	}
+	// every corner of a moved triangle has its normal change, not only the corners that moved
+	std::set<int> touchedVertices;
+	for (int triangleIndex : movedTriangles) {
+		this->updateTriangleGeometry(triangleIndex);
+		touchedVertices.insert(this->loadedTriangles[triangleIndex].vertices.begin(), this->loadedTriangles[triangleIndex].vertices.end());
+	}
+	for (int vertexIndex : touchedVertices) this->updateVertexNormal(vertexIndex);
+
+	this->accelerator.refit(*this, std::vector<int>(movedTriangles.begin(), movedTriangles.end()));
+	// the top level root bounds every triangle, so the scene bounds come from it instead of another pass over them
+	const BVHNode& sceneRoot = this->accelerator.topLevel.nodes[0];
+	this->sceneBoundingMinMax = { sceneRoot.boundsMin, sceneRoot.boundsMax };
+}
+
+void PolygonData::translateObject(const std::string& objectName, glm::vec3 offset) {
+	std::set<int> vertexSet;
+	for (const ModelTriangle& triangle : this->loadedTriangles) {
+		if (triangle.objectName != objectName) continue;
+		vertexSet.insert(triangle.vertices.begin(), triangle.vertices.end());
+	}
+	std::vector<int> vertexIndices(vertexSet.begin(), vertexSet.end());
+	std::vector<glm::vec3> positions;
+	for (int vertexIndex : vertexIndices) {
+		positions.push_back(this->loadedVertices[vertexIndex].position + offset);
+	}
+	this->updateVertexPositions(vertexIndices, positions);
+}
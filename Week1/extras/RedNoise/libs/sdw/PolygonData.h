@@ -2,6 +2,7 @@
 #include <vector>
 #include <unordered_map>
 #include "ModelTriangle.h"
+#include "SceneAccelerator.h"
 #include <set>
 
 struct PolygonData {
@@ -10,6 +11,7 @@ struct PolygonData {
 	std::vector<GouraudVertex> loadedVertices;
 	std::vector<TexturePoint> loadedTextures;
 	std::pair<glm::vec3, glm::vec3> sceneBoundingMinMax;
+	SceneAccelerator accelerator;
 
 	PolygonData();
 	PolygonData(std::unordered_map<int, std::set<int>> vertexToTriangles,
@@ -22,4 +24,19 @@ struct PolygonData {
 	glm::vec3 getTriangleVertexPosition(int triangleIndex, int triangleVertexIndex);
 
 	std::array<glm::vec2, 3> getTextureVertices(int triangleIndex);
+
+	// recomputes face normals, bounding boxes and vertex normals from the vertex positions
+	void computeTriangleGeometry();
+
+	// the same for the normal and bounds of one triangle
+	void updateTriangleGeometry(int triangleIndex);
+
+	// the same for the normal of one vertex, from the triangles around it
+	void updateVertexNormal(int vertexIndex);
+
+	// moves vertices for animation. only the triangles around them are recomputed, and only the trees of the objects
+	// they belong to are refitted, instead of rebuilding the accelerator
+	void updateVertexPositions(const std::vector<int>& vertexIndices, const std::vector<glm::vec3>& positions);
+
+	void translateObject(const std::string& objectName, glm::vec3 offset);
 };
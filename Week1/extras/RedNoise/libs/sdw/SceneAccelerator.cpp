@@ -0,0 +1,235 @@
+#include "SceneAccelerator.h"
+#include "PolygonData.h"
+#include <unordered_map>
+
+namespace {
+	// the top level tree comes from the same builder, whose depth cap keeps a binary traversal within this
+	const int MAX_STACK_SIZE = 64;
+	// how much worse than freshly built a refitted tree may get before it is rebuilt
+	const float REBUILD_THRESHOLD = 1.5f;
+
+	struct StackEntry {
+		int nodeIndex;
+		float entryDistance;
+	};
+
+	std::vector<std::pair<glm::vec3, glm::vec3>> getTriangleBounds(PolygonData& objects) {
+		std::vector<std::pair<glm::vec3, glm::vec3>> triangleBounds(objects.loadedTriangles.size());
+		for (int triangleIndex = 0; triangleIndex < int(objects.loadedTriangles.size()); triangleIndex++) {
+			triangleBounds[triangleIndex] = objects.loadedTriangles[triangleIndex].boundingMinMax;
+		}
+		return triangleBounds;
+	}
+
+	void refitOrRebuild(BoundingVolumeHierarchy& bvh, const std::vector<std::pair<glm::vec3, glm::vec3>>& primitiveBounds) {
+		if (bvh.nodes.empty()) return;
+		bvh.refit(primitiveBounds);
+		if (bvh.surfaceAreaCost() > bvh.builtCost * REBUILD_THRESHOLD) {
+			std::vector<int> primitives = bvh.primitiveIndices;
+			bvh.build(primitiveBounds, primitives);
+		}
+	}
+}
+
+SceneAccelerator::SceneAccelerator() : layout(WIDE_LAYOUT), version(0) {}
+
+void SceneAccelerator::build(PolygonData& objects) {
+	version++;
+	instances.clear();
+	triangleBounds = getTriangleBounds(objects);
+	std::vector<std::vector<int>> instanceTriangles;
+	std::unordered_map<std::string, int> instanceLookup;
+	for (int triangleIndex = 0; triangleIndex < int(objects.loadedTriangles.size()); triangleIndex++) {
+		const ModelTriangle& triangle = objects.loadedTriangles[triangleIndex];
+		auto instance = instanceLookup.find(triangle.objectName);
+		if (instance == instanceLookup.end()) {
+			instance = instanceLookup.emplace(triangle.objectName, int(instances.size())).first;
+			instances.push_back({ triangle.objectName, BoundingVolumeHierarchy(), true });
+			instanceTriangles.emplace_back();
+		}
+		instanceTriangles[instance->second].push_back(triangleIndex);
+	}
+
+	std::vector<std::pair<glm::vec3, glm::vec3>> instanceBounds(instances.size());
+	std::vector<int> instanceIndices(instances.size());
+	for (int instanceIndex = 0; instanceIndex < int(instances.size()); instanceIndex++) {
+		BoundingVolumeHierarchy& bvh = instances[instanceIndex].bvh;
+		bvh.build(triangleBounds, instanceTriangles[instanceIndex]);
+		bvh.updateTriangleRecords(objects);
+		instanceBounds[instanceIndex] = { bvh.nodes[0].boundsMin, bvh.nodes[0].boundsMax };
+		instanceIndices[instanceIndex] = instanceIndex;
+	}
+	topLevel.build(instanceBounds, instanceIndices);
+}
+
+void SceneAccelerator::refit(PolygonData& objects) {
+	triangleBounds = getTriangleBounds(objects);
+	refitInstances(objects, std::vector<bool>(instances.size(), true));
+}
+
+void SceneAccelerator::refit(PolygonData& objects, const std::vector<int>& movedTriangles) {
+	// a cache load restores the trees without the bounds they were built over
+	if (triangleBounds.size() != objects.loadedTriangles.size()) {
+		refit(objects);
+		return;
+	}
+	std::unordered_map<std::string, int> instanceLookup;
+	for (int instanceIndex = 0; instanceIndex < int(instances.size()); instanceIndex++) instanceLookup[instances[instanceIndex].objectName] = instanceIndex;
+	std::vector<bool> refitted(instances.size(), false);
+	for (int triangleIndex : movedTriangles) {
+		triangleBounds[triangleIndex] = objects.loadedTriangles[triangleIndex].boundingMinMax;
+		refitted[instanceLookup[objects.loadedTriangles[triangleIndex].objectName]] = true;
+	}
+	refitInstances(objects, refitted);
+}
+
+void SceneAccelerator::refitInstances(PolygonData& objects, const std::vector<bool>& refitted) {
+	version++;
+	std::vector<std::pair<glm::vec3, glm::vec3>> instanceBounds(instances.size());
+	for (int instanceIndex = 0; instanceIndex < int(instances.size()); instanceIndex++) {
+		BoundingVolumeHierarchy& bvh = instances[instanceIndex].bvh;
+		if (refitted[instanceIndex]) {
+			refitOrRebuild(bvh, triangleBounds);
+			bvh.updateTriangleRecords(objects);
+		}
+		instanceBounds[instanceIndex] = { bvh.nodes[0].boundsMin, bvh.nodes[0].boundsMax };
+	}
+	refitOrRebuild(topLevel, instanceBounds);
+}
+
+size_t SceneAccelerator::nodeMemory(BVHLayout nodeLayout) const {
+	size_t bytes = topLevel.nodeMemory(BINARY_LAYOUT);
+	for (const ObjectInstance& instance : instances) bytes += instance.bvh.nodeMemory(nodeLayout);
+	return bytes;
+}
+
+void SceneAccelerator::setHiddenObjects(const std::set<std::string>& hiddenObjects) {
+	for (auto& instance : instances) {
+		bool visible = hiddenObjects.find(instance.objectName) == hiddenObjects.end();
+		if (visible != instance.visible) version++;
+		instance.visible = visible;
+	}
+}
+
+bool SceneAccelerator::intersect(const glm::vec3& origin, const glm::vec3& direction, BVHHit& hit,
+	int excludeID, float maxDistance) const {
+	if (topLevel.nodes.empty()) return false;
+	glm::vec3 invertedDirection = 1.0f / direction;
+	BVHHit closest;
+	closest.distance = maxDistance;
+	closest.triangleIndex = -1;
+	bool found = false;
+
+	StackEntry stack[MAX_STACK_SIZE];
+	int stackSize = 0;
+	float rootEntry = BoundingVolumeHierarchy::slabEntry(topLevel.nodes[0], origin, invertedDirection, closest.distance);
+	if (rootEntry == std::numeric_limits<float>::infinity()) return false;
+	stack[stackSize++] = { 0, rootEntry };
+
+	while (stackSize > 0) {
+		StackEntry current = stack[--stackSize];
+		if (current.entryDistance > closest.distance) continue;
+		const BVHNode& node = topLevel.nodes[current.nodeIndex];
+
+		if (node.triangleCount > 0) {
+			for (int i = node.leftFirst; i < node.leftFirst + node.triangleCount; i++) {
+				const ObjectInstance& instance = instances[topLevel.primitiveIndices[i]];
+				if (!instance.visible) continue;
+				bool instanceHit;
+				if (layout == WIDE_LAYOUT) instanceHit = instance.bvh.intersectWide(origin, direction, closest, excludeID, closest.distance);
+				else if (layout == QUANTIZED_LAYOUT) instanceHit = instance.bvh.intersectQuantized(origin, direction, closest, excludeID, closest.distance);
+				else instanceHit = instance.bvh.intersect(origin, direction, closest, excludeID, closest.distance);
+				if (instanceHit) found = true;
+			}
+			continue;
+		}
+
+		float leftEntry = BoundingVolumeHierarchy::slabEntry(topLevel.nodes[node.leftFirst], origin, invertedDirection, closest.distance);
+		float rightEntry = BoundingVolumeHierarchy::slabEntry(topLevel.nodes[node.leftFirst + 1], origin, invertedDirection, closest.distance);
+		StackEntry nearChild = { node.leftFirst, leftEntry };
+		StackEntry farChild = { node.leftFirst + 1, rightEntry };
+		if (rightEntry < leftEntry) std::swap(nearChild, farChild);
+		if (farChild.entryDistance != std::numeric_limits<float>::infinity()) stack[stackSize++] = farChild;
+		if (nearChild.entryDistance != std::numeric_limits<float>::infinity()) stack[stackSize++] = nearChild;
+	}
+	if (found) hit = closest;
+	return found;
+}
+
+void SceneAccelerator::intersectPacket(RayPacket& packet) const {
+	if (!packet.coherent) {
+		for (int ray = 0; ray < packet.rayCount; ray++) {
+			glm::vec3 direction(packet.directionX[ray], packet.directionY[ray], packet.directionZ[ray]);
+			if (intersect(packet.origin, direction, packet.hits[ray], -1, packet.closest[ray])) {
+				packet.closest[ray] = packet.hits[ray].distance;
+			}
+		}
+		return;
+	}
+	if (topLevel.nodes.empty()) return;
+
+	StackEntry stack[MAX_STACK_SIZE];
+	int stackSize = 0;
+	float rootEntry = BoundingVolumeHierarchy::packetEntry(topLevel.nodes[0], packet, std::numeric_limits<float>::max());
+	if (rootEntry == std::numeric_limits<float>::infinity()) return;
+	stack[stackSize++] = { 0, rootEntry };
+
+	while (stackSize > 0) {
+		StackEntry current = stack[--stackSize];
+		float furthest = 0;
+		for (int ray = 0; ray < packet.rayCount; ray++) furthest = glm::max(furthest, packet.closest[ray]);
+		if (current.entryDistance > furthest) continue;
+		const BVHNode& node = topLevel.nodes[current.nodeIndex];
+
+		if (node.triangleCount > 0) {
+			for (int i = node.leftFirst; i < node.leftFirst + node.triangleCount; i++) {
+				const ObjectInstance& instance = instances[topLevel.primitiveIndices[i]];
+				if (!instance.visible) continue;
+				instance.bvh.intersectPacket(packet);
+			}
+			continue;
+		}
+
+		float leftEntry = BoundingVolumeHierarchy::packetEntry(topLevel.nodes[node.leftFirst], packet, furthest);
+		float rightEntry = BoundingVolumeHierarchy::packetEntry(topLevel.nodes[node.leftFirst + 1], packet, furthest);
+		StackEntry nearChild = { node.leftFirst, leftEntry };
+		StackEntry farChild = { node.leftFirst + 1, rightEntry };
+		if (rightEntry < leftEntry) std::swap(nearChild, farChild);
+		if (farChild.entryDistance != std::numeric_limits<float>::infinity()) stack[stackSize++] = farChild;
+		if (nearChild.entryDistance != std::numeric_limits<float>::infinity()) stack[stackSize++] = nearChild;
+	}
+}
+
+bool SceneAccelerator::occluded(const glm::vec3& origin, const glm::vec3& direction, int excludeID, float maxDistance) const {
+	if (topLevel.nodes.empty()) return false;
+	glm::vec3 invertedDirection = 1.0f / direction;
+
+	int stack[MAX_STACK_SIZE];
+	int stackSize = 0;
+	if (BoundingVolumeHierarchy::slabEntry(topLevel.nodes[0], origin, invertedDirection, maxDistance) == std::numeric_limits<float>::infinity()) return false;
+	stack[stackSize++] = 0;
+
+	while (stackSize > 0) {
+		const BVHNode& node = topLevel.nodes[stack[--stackSize]];
+
+		if (node.triangleCount > 0) {
+			for (int i = node.leftFirst; i < node.leftFirst + node.triangleCount; i++) {
+				const ObjectInstance& instance = instances[topLevel.primitiveIndices[i]];
+				if (!instance.visible) continue;
+				bool instanceHit;
+				if (layout == WIDE_LAYOUT) instanceHit = instance.bvh.occludedWide(origin, direction, excludeID, maxDistance);
+				else if (layout == QUANTIZED_LAYOUT) instanceHit = instance.bvh.occludedQuantized(origin, direction, excludeID, maxDistance);
+				else instanceHit = instance.bvh.occluded(origin, direction, excludeID, maxDistance);
+				if (instanceHit) return true;
+			}
+			continue;
+		}
+
+		for (int child = node.leftFirst; child <= node.leftFirst + 1; child++) {
+			if (BoundingVolumeHierarchy::slabEntry(topLevel.nodes[child], origin, invertedDirection, maxDistance) != std::numeric_limits<float>::infinity()) {
+				stack[stackSize++] = child;
+			}
+		}
+	}
+	return false;
+}
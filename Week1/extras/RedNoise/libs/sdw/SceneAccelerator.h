@@ -0,0 +1,53 @@
+#pragma once
+#include <string>
+#include <set>
+#include "BoundingVolumeHierarchy.h"
+
+struct ObjectInstance {
+	std::string objectName;
+	BoundingVolumeHierarchy bvh;
+	bool visible; // mask bit, hidden instances are skipped as a whole during traversal
+};
+
+// two-level structure: a top level tree over one bottom level tree per named object
+class SceneAccelerator {
+private:
+	std::vector<std::pair<glm::vec3, glm::vec3>> triangleBounds; // of every triangle as of the last build or refit
+
+	// refits the trees of the instances marked in refitted, then the top level tree over all of them
+	void refitInstances(PolygonData& objects, const std::vector<bool>& refitted);
+
+public:
+	std::vector<ObjectInstance> instances;
+	BoundingVolumeHierarchy topLevel;
+	BVHLayout layout; // which nodes the object trees are traversed through
+	unsigned version; // bumped whenever a build, refit or mask change alters what rays can hit
+
+	SceneAccelerator();
+
+	// groups triangles by objectName and builds every tree, triangles need their boundingMinMax set
+	void build(PolygonData& objects);
+
+	// refits every tree to the current triangle bounds, rebuilding any whose surface area cost degraded too far
+	void refit(PolygonData& objects);
+
+	// the same, but only the trees of the objects the given triangles belong to are refitted before the top level one
+	void refit(PolygonData& objects, const std::vector<int>& movedTriangles);
+
+	// bytes taken by the nodes of every tree in the given layout, the top level tree is always binary
+	size_t nodeMemory(BVHLayout nodeLayout) const;
+
+	// updates the instance masks, the version only moves when one of them actually changed
+	void setHiddenObjects(const std::set<std::string>& hiddenObjects);
+
+	// closest hit over every visible instance, hit is only written when true is returned
+	bool intersect(const glm::vec3& origin, const glm::vec3& direction, BVHHit& hit,
+		int excludeID = -1, float maxDistance = std::numeric_limits<float>::max()) const;
+
+	// closest hit for every ray of the packet over the visible instances. packets that are not coherent
+	// have no usable frustum and are traced one ray at a time instead
+	void intersectPacket(RayPacket& packet) const;
+
+	// true when any visible triangle other than excludeID lies on the ray within maxDistance
+	bool occluded(const glm::vec3& origin, const glm::vec3& direction, int excludeID, float maxDistance) const;
+};
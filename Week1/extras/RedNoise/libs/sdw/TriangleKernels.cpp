@@ -0,0 +1,425 @@
+#include "TriangleKernels.h"
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__)
+#define USE_X86_KERNELS
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+// MSVC accepts AVX intrinsics in any function
+#define AVX2_FUNCTION
+#else
+// only this function is compiled for AVX2, so the rest of the program still runs on older CPUs
+#define AVX2_FUNCTION __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace {
+	const float PARALLEL_EPSILON = 1e-10f;
+
+	bool acceptsHit(float distance, int triangleIndex, float closest, const BVHHit& hit) {
+		if (distance > closest) return false;
+		return distance != closest || triangleIndex >= hit.triangleIndex;
+	}
+
+	// Moller-Trumbore, solves origin + t * direction = v0 + u * e0 + v * e1 without building the matrix
+	bool intersectTriangle(const TriangleRecord& record, const glm::vec3& origin, const glm::vec3& direction, float maxDistance, BVHHit& hit) {
+		glm::vec3 directionCrossE1 = glm::cross(direction, record.e1);
+		float determinant = glm::dot(record.e0, directionCrossE1);
+		// the ray runs parallel to the triangle's plane
+		if (glm::abs(determinant) < PARALLEL_EPSILON) return false;
+		float inverseDeterminant = 1.0f / determinant;
+
+		glm::vec3 SPVector = origin - record.v0;
+		float u = glm::dot(SPVector, directionCrossE1) * inverseDeterminant;
+		if (u < 0.0 || u > 1.0) return false;
+		glm::vec3 SPCrossE0 = glm::cross(SPVector, record.e0);
+		float v = glm::dot(direction, SPCrossE0) * inverseDeterminant;
+		if (v < 0.0 || u + v > 1.0) return false;
+		float t = glm::dot(record.e1, SPCrossE0) * inverseDeterminant;
+		if (t > maxDistance || t < 0) return false;
+		hit = { t, u, v, record.triangleIndex };
+		return true;
+	}
+
+	// picks the closest lane out of the lanes that passed the SIMD tests
+	bool resolveLanes(int laneMask, const float* t, const float* u, const float* v, const int* triangleIndices,
+		int excludeID, float& closest, BVHHit& hit) {
+		bool found = false;
+		for (int lane = 0; lane < PACKET_WIDTH; lane++) {
+			if (!(laneMask & (1 << lane))) continue;
+			if (triangleIndices[lane] == excludeID) continue;
+			if (!acceptsHit(t[lane], triangleIndices[lane], closest, hit)) continue;
+			hit = { t[lane], u[lane], v[lane], triangleIndices[lane] };
+			closest = t[lane];
+			found = true;
+		}
+		return found;
+	}
+
+#ifdef USE_X86_KERNELS
+	int testLanesSSE(const TrianglePacket& packet, int offset, const glm::vec3& origin, const glm::vec3& direction, float closest,
+		float* t, float* u, float* v) {
+		__m128 dx = _mm_set1_ps(direction.x), dy = _mm_set1_ps(direction.y), dz = _mm_set1_ps(direction.z);
+		__m128 e0x = _mm_loadu_ps(packet.e0x + offset), e0y = _mm_loadu_ps(packet.e0y + offset), e0z = _mm_loadu_ps(packet.e0z + offset);
+		__m128 e1x = _mm_loadu_ps(packet.e1x + offset), e1y = _mm_loadu_ps(packet.e1y + offset), e1z = _mm_loadu_ps(packet.e1z + offset);
+
+		// directionCrossE1
+		__m128 px = _mm_sub_ps(_mm_mul_ps(dy, e1z), _mm_mul_ps(dz, e1y));
+		__m128 py = _mm_sub_ps(_mm_mul_ps(dz, e1x), _mm_mul_ps(dx, e1z));
+		__m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e1y), _mm_mul_ps(dy, e1x));
+		__m128 determinant = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e0x, px), _mm_mul_ps(e0y, py)), _mm_mul_ps(e0z, pz));
+		__m128 absDeterminant = _mm_andnot_ps(_mm_set1_ps(-0.0f), determinant);
+		__m128 mask = _mm_cmpge_ps(absDeterminant, _mm_set1_ps(PARALLEL_EPSILON));
+		__m128 inverseDeterminant = _mm_div_ps(_mm_set1_ps(1.0f), determinant);
+
+		// SPVector
+		__m128 sx = _mm_sub_ps(_mm_set1_ps(origin.x), _mm_loadu_ps(packet.v0x + offset));
+		__m128 sy = _mm_sub_ps(_mm_set1_ps(origin.y), _mm_loadu_ps(packet.v0y + offset));
+		__m128 sz = _mm_sub_ps(_mm_set1_ps(origin.z), _mm_loadu_ps(packet.v0z + offset));
+		__m128 uLanes = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), inverseDeterminant);
+
+		// SPCrossE0
+		__m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e0z), _mm_mul_ps(sz, e0y));
+		__m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e0x), _mm_mul_ps(sx, e0z));
+		__m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e0y), _mm_mul_ps(sy, e0x));
+		__m128 vLanes = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), inverseDeterminant);
+		__m128 tLanes = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, qx), _mm_mul_ps(e1y, qy)), _mm_mul_ps(e1z, qz)), inverseDeterminant);
+
+		__m128 zero = _mm_setzero_ps();
+		__m128 one = _mm_set1_ps(1.0f);
+		mask = _mm_and_ps(mask, _mm_cmpge_ps(uLanes, zero));
+		mask = _mm_and_ps(mask, _mm_cmple_ps(uLanes, one));
+		mask = _mm_and_ps(mask, _mm_cmpge_ps(vLanes, zero));
+		mask = _mm_and_ps(mask, _mm_cmple_ps(_mm_add_ps(uLanes, vLanes), one));
+		mask = _mm_and_ps(mask, _mm_cmpge_ps(tLanes, zero));
+		mask = _mm_and_ps(mask, _mm_cmple_ps(tLanes, _mm_set1_ps(closest)));
+		int laneMask = _mm_movemask_ps(mask);
+		if (laneMask == 0) return 0;
+		_mm_storeu_ps(t + offset, tLanes);
+		_mm_storeu_ps(u + offset, uLanes);
+		_mm_storeu_ps(v + offset, vLanes);
+		return laneMask << offset;
+	}
+
+	AVX2_FUNCTION int testLanesAVX2(const TrianglePacket& packet, const glm::vec3& origin, const glm::vec3& direction, float closest,
+		float* t, float* u, float* v) {
+		__m256 dx = _mm256_set1_ps(direction.x), dy = _mm256_set1_ps(direction.y), dz = _mm256_set1_ps(direction.z);
+		__m256 e0x = _mm256_loadu_ps(packet.e0x), e0y = _mm256_loadu_ps(packet.e0y), e0z = _mm256_loadu_ps(packet.e0z);
+		__m256 e1x = _mm256_loadu_ps(packet.e1x), e1y = _mm256_loadu_ps(packet.e1y), e1z = _mm256_loadu_ps(packet.e1z);
+
+		// directionCrossE1
+		__m256 px = _mm256_sub_ps(_mm256_mul_ps(dy, e1z), _mm256_mul_ps(dz, e1y));
+		__m256 py = _mm256_sub_ps(_mm256_mul_ps(dz, e1x), _mm256_mul_ps(dx, e1z));
+		__m256 pz = _mm256_sub_ps(_mm256_mul_ps(dx, e1y), _mm256_mul_ps(dy, e1x));
+		__m256 determinant = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e0x, px), _mm256_mul_ps(e0y, py)), _mm256_mul_ps(e0z, pz));
+		__m256 absDeterminant = _mm256_andnot_ps(_mm256_set1_ps(-0.0f), determinant);
+		__m256 mask = _mm256_cmp_ps(absDeterminant, _mm256_set1_ps(PARALLEL_EPSILON), _CMP_GE_OQ);
+		__m256 inverseDeterminant = _mm256_div_ps(_mm256_set1_ps(1.0f), determinant);
+
+		// SPVector
+		__m256 sx = _mm256_sub_ps(_mm256_set1_ps(origin.x), _mm256_loadu_ps(packet.v0x));
+		__m256 sy = _mm256_sub_ps(_mm256_set1_ps(origin.y), _mm256_loadu_ps(packet.v0y));
+		__m256 sz = _mm256_sub_ps(_mm256_set1_ps(origin.z), _mm256_loadu_ps(packet.v0z));
+		__m256 uLanes = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(sx, px), _mm256_mul_ps(sy, py)), _mm256_mul_ps(sz, pz)), inverseDeterminant);
+
+		// SPCrossE0
+		__m256 qx = _mm256_sub_ps(_mm256_mul_ps(sy, e0z), _mm256_mul_ps(sz, e0y));
+		__m256 qy = _mm256_sub_ps(_mm256_mul_ps(sz, e0x), _mm256_mul_ps(sx, e0z));
+		__m256 qz = _mm256_sub_ps(_mm256_mul_ps(sx, e0y), _mm256_mul_ps(sy, e0x));
+		__m256 vLanes = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, qx), _mm256_mul_ps(dy, qy)), _mm256_mul_ps(dz, qz)), inverseDeterminant);
+		__m256 tLanes = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e1x, qx), _mm256_mul_ps(e1y, qy)), _mm256_mul_ps(e1z, qz)), inverseDeterminant);
+
+		__m256 zero = _mm256_setzero_ps();
+		__m256 one = _mm256_set1_ps(1.0f);
+		mask = _mm256_and_ps(mask, _mm256_cmp_ps(uLanes, zero, _CMP_GE_OQ));
+		mask = _mm256_and_ps(mask, _mm256_cmp_ps(uLanes, one, _CMP_LE_OQ));
+		mask = _mm256_and_ps(mask, _mm256_cmp_ps(vLanes, zero, _CMP_GE_OQ));
+		mask = _mm256_and_ps(mask, _mm256_cmp_ps(_mm256_add_ps(uLanes, vLanes), one, _CMP_LE_OQ));
+		mask = _mm256_and_ps(mask, _mm256_cmp_ps(tLanes, zero, _CMP_GE_OQ));
+		mask = _mm256_and_ps(mask, _mm256_cmp_ps(tLanes, _mm256_set1_ps(closest), _CMP_LE_OQ));
+		int laneMask = _mm256_movemask_ps(mask);
+		if (laneMask == 0) return 0;
+		_mm256_storeu_ps(t, tLanes);
+		_mm256_storeu_ps(u, uLanes);
+		_mm256_storeu_ps(v, vLanes);
+		return laneMask;
+	}
+
+	// fills t, u and v for the lanes set in the returned mask, which hit within closest
+	int testLanes(const TrianglePacket& packet, const glm::vec3& origin, const glm::vec3& direction, float closest,
+		float* t, float* u, float* v) {
+		if (activeTriangleKernel == AVX2_KERNEL) return testLanesAVX2(packet, origin, direction, closest, t, u, v);
+		return testLanesSSE(packet, 0, origin, direction, closest, t, u, v) |
+			testLanesSSE(packet, 4, origin, direction, closest, t, u, v);
+	}
+
+	int slabTestSSE(__m128 minX, __m128 minY, __m128 minZ, __m128 maxX, __m128 maxY, __m128 maxZ, int childCount,
+		const glm::vec3& origin, const glm::vec3& invertedDirection, float maxDistance, float* entries) {
+		__m128 ix = _mm_set1_ps(invertedDirection.x), iy = _mm_set1_ps(invertedDirection.y), iz = _mm_set1_ps(invertedDirection.z);
+		minX = _mm_mul_ps(_mm_sub_ps(minX, _mm_set1_ps(origin.x)), ix);
+		minY = _mm_mul_ps(_mm_sub_ps(minY, _mm_set1_ps(origin.y)), iy);
+		minZ = _mm_mul_ps(_mm_sub_ps(minZ, _mm_set1_ps(origin.z)), iz);
+		maxX = _mm_mul_ps(_mm_sub_ps(maxX, _mm_set1_ps(origin.x)), ix);
+		maxY = _mm_mul_ps(_mm_sub_ps(maxY, _mm_set1_ps(origin.y)), iy);
+		maxZ = _mm_mul_ps(_mm_sub_ps(maxZ, _mm_set1_ps(origin.z)), iz);
+		__m128 entry = _mm_max_ps(_mm_max_ps(_mm_min_ps(minX, maxX), _mm_min_ps(minY, maxY)), _mm_min_ps(minZ, maxZ));
+		__m128 exit = _mm_min_ps(_mm_min_ps(_mm_max_ps(minX, maxX), _mm_max_ps(minY, maxY)), _mm_max_ps(minZ, maxZ));
+		__m128 mask = _mm_cmpge_ps(exit, entry);
+		mask = _mm_and_ps(mask, _mm_cmpge_ps(exit, _mm_setzero_ps()));
+		mask = _mm_and_ps(mask, _mm_cmple_ps(entry, _mm_set1_ps(maxDistance)));
+		_mm_storeu_ps(entries, entry);
+		return _mm_movemask_ps(mask) & ((1 << childCount) - 1);
+	}
+
+	int intersectWideNodeBoundsSSE(const WideBVHNode& node, const glm::vec3& origin, const glm::vec3& invertedDirection, float maxDistance,
+		float* entries) {
+		return slabTestSSE(_mm_load_ps(node.boundsMinX), _mm_load_ps(node.boundsMinY), _mm_load_ps(node.boundsMinZ),
+			_mm_load_ps(node.boundsMaxX), _mm_load_ps(node.boundsMaxY), _mm_load_ps(node.boundsMaxZ), node.childCount,
+			origin, invertedDirection, maxDistance, entries);
+	}
+
+	// widens four 8-bit offsets to floats and scales them into the node's frame
+	__m128 decodeSSE(const uint8_t* quantized, float origin, float scale) {
+		int packed;
+		std::memcpy(&packed, quantized, sizeof(packed));
+		__m128i zero = _mm_setzero_si128();
+		__m128i widened = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), zero), zero);
+		return _mm_add_ps(_mm_set1_ps(origin), _mm_mul_ps(_mm_cvtepi32_ps(widened), _mm_set1_ps(scale)));
+	}
+
+	int intersectQuantizedNodeBoundsSSE(const QuantizedBVHNode& node, const glm::vec3& origin, const glm::vec3& invertedDirection, float maxDistance,
+		float* entries) {
+		float scaleX = quantizedScale(node.exponent[0]), scaleY = quantizedScale(node.exponent[1]), scaleZ = quantizedScale(node.exponent[2]);
+		return slabTestSSE(decodeSSE(node.boundsMinX, node.origin.x, scaleX), decodeSSE(node.boundsMinY, node.origin.y, scaleY),
+			decodeSSE(node.boundsMinZ, node.origin.z, scaleZ), decodeSSE(node.boundsMaxX, node.origin.x, scaleX),
+			decodeSSE(node.boundsMaxY, node.origin.y, scaleY), decodeSSE(node.boundsMaxZ, node.origin.z, scaleZ), node.childCount,
+			origin, invertedDirection, maxDistance, entries);
+	}
+
+	bool supportsAVX2() {
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7) return false;
+		__cpuid(info, 1);
+		bool osSavesAVX = (info[2] & (1 << 27)) && (info[2] & (1 << 28));
+		if (!osSavesAVX || (_xgetbv(0) & 6) != 6) return false;
+		__cpuidex(info, 7, 0);
+		return info[1] & (1 << 5);
+#else
+		return __builtin_cpu_supports("avx2");
+#endif
+	}
+#endif
+
+	bool intersectPacketScalar(const TrianglePacket& packet, const glm::vec3& origin, const glm::vec3& direction,
+		int excludeID, float& closest, BVHHit& hit) {
+		bool found = false;
+		for (int lane = 0; lane < PACKET_WIDTH; lane++) {
+			if (packet.triangleIndex[lane] == -1) continue;
+			TriangleRecord record;
+			record.v0 = { packet.v0x[lane], packet.v0y[lane], packet.v0z[lane] };
+			record.e0 = { packet.e0x[lane], packet.e0y[lane], packet.e0z[lane] };
+			record.e1 = { packet.e1x[lane], packet.e1y[lane], packet.e1z[lane] };
+			record.triangleIndex = packet.triangleIndex[lane];
+			if (intersectTriangleRecords(&record, 1, origin, direction, excludeID, closest, hit)) found = true;
+		}
+		return found;
+	}
+
+	bool occludedPacketScalar(const TrianglePacket& packet, const glm::vec3& origin, const glm::vec3& direction,
+		int excludeID, float maxDistance) {
+		for (int lane = 0; lane < PACKET_WIDTH; lane++) {
+			if (packet.triangleIndex[lane] == -1) continue;
+			TriangleRecord record;
+			record.v0 = { packet.v0x[lane], packet.v0y[lane], packet.v0z[lane] };
+			record.e0 = { packet.e0x[lane], packet.e0y[lane], packet.e0z[lane] };
+			record.e1 = { packet.e1x[lane], packet.e1y[lane], packet.e1z[lane] };
+			record.triangleIndex = packet.triangleIndex[lane];
+			if (occludedTriangleRecords(&record, 1, origin, direction, excludeID, maxDistance)) return true;
+		}
+		return false;
+	}
+
+	TriangleKernel detectTriangleKernel() {
+#ifdef USE_X86_KERNELS
+		return supportsAVX2() ? AVX2_KERNEL : SSE_KERNEL;
+#else
+		return SCALAR_KERNEL;
+#endif
+	}
+}
+
+const TriangleKernel activeTriangleKernel = detectTriangleKernel();
+
+const char* getTriangleKernelName(TriangleKernel kernel) {
+	if (kernel == AVX2_KERNEL) return "avx2";
+	if (kernel == SSE_KERNEL) return "sse";
+	return "scalar";
+}
+
+void fillTrianglePacket(TrianglePacket& packet, const TriangleRecord* records, int count) {
+	for (int lane = 0; lane < PACKET_WIDTH; lane++) {
+		TriangleRecord record = {};
+		record.triangleIndex = -1;
+		if (lane < count) record = records[lane];
+		packet.v0x[lane] = record.v0.x;
+		packet.v0y[lane] = record.v0.y;
+		packet.v0z[lane] = record.v0.z;
+		packet.e0x[lane] = record.e0.x;
+		packet.e0y[lane] = record.e0.y;
+		packet.e0z[lane] = record.e0.z;
+		packet.e1x[lane] = record.e1.x;
+		packet.e1y[lane] = record.e1.y;
+		packet.e1z[lane] = record.e1.z;
+		packet.triangleIndex[lane] = record.triangleIndex;
+	}
+}
+
+bool intersectTriangleRecords(const TriangleRecord* records, int count, const glm::vec3& origin, const glm::vec3& direction,
+	int excludeID, float& closest, BVHHit& hit) {
+	bool found = false;
+	for (int i = 0; i < count; i++) {
+		if (records[i].triangleIndex == excludeID) continue;
+		BVHHit candidate;
+		if (!intersectTriangle(records[i], origin, direction, closest, candidate)) continue;
+		if (!acceptsHit(candidate.distance, candidate.triangleIndex, closest, hit)) continue;
+		hit = candidate;
+		closest = candidate.distance;
+		found = true;
+	}
+	return found;
+}
+
+bool intersectTrianglePacket(const TrianglePacket& packet, const glm::vec3& origin, const glm::vec3& direction,
+	int excludeID, float& closest, BVHHit& hit) {
+#ifdef USE_X86_KERNELS
+	if (activeTriangleKernel != SCALAR_KERNEL) {
+		float t[PACKET_WIDTH], u[PACKET_WIDTH], v[PACKET_WIDTH];
+		int laneMask = testLanes(packet, origin, direction, closest, t, u, v);
+		if (laneMask == 0) return false;
+		return resolveLanes(laneMask, t, u, v, packet.triangleIndex, excludeID, closest, hit);
+	}
+#endif
+	return intersectPacketScalar(packet, origin, direction, excludeID, closest, hit);
+}
+
+namespace {
+	bool slabTest(const glm::vec3& boundsMin, const glm::vec3& boundsMax, const glm::vec3& origin, const glm::vec3& invertedDirection,
+		float maxDistance, float& entry) {
+		glm::vec3 rayMin = (boundsMin - origin) * invertedDirection;
+		glm::vec3 rayMax = (boundsMax - origin) * invertedDirection;
+		glm::vec3 nearest = glm::min(rayMin, rayMax);
+		glm::vec3 furthest = glm::max(rayMin, rayMax);
+		entry = glm::max(glm::max(nearest.x, nearest.y), nearest.z);
+		float exit = glm::min(glm::min(furthest.x, furthest.y), furthest.z);
+		return exit >= entry && exit >= 0 && entry <= maxDistance;
+	}
+}
+
+int intersectWideNodeBounds(const WideBVHNode& node, const glm::vec3& origin, const glm::vec3& invertedDirection, float maxDistance,
+	float* entries) {
+#ifdef USE_X86_KERNELS
+	if (activeTriangleKernel != SCALAR_KERNEL) return intersectWideNodeBoundsSSE(node, origin, invertedDirection, maxDistance, entries);
+#endif
+	int childMask = 0;
+	for (int child = 0; child < node.childCount; child++) {
+		glm::vec3 boundsMin(node.boundsMinX[child], node.boundsMinY[child], node.boundsMinZ[child]);
+		glm::vec3 boundsMax(node.boundsMaxX[child], node.boundsMaxY[child], node.boundsMaxZ[child]);
+		if (slabTest(boundsMin, boundsMax, origin, invertedDirection, maxDistance, entries[child])) childMask |= 1 << child;
+	}
+	return childMask;
+}
+
+float quantizedScale(int8_t exponent) {
+	uint32_t bits = uint32_t(exponent + 127) << 23;
+	float scale;
+	std::memcpy(&scale, &bits, sizeof(scale));
+	return scale;
+}
+
+int intersectQuantizedNodeBounds(const QuantizedBVHNode& node, const glm::vec3& origin, const glm::vec3& invertedDirection, float maxDistance,
+	float* entries) {
+#ifdef USE_X86_KERNELS
+	if (activeTriangleKernel != SCALAR_KERNEL) return intersectQuantizedNodeBoundsSSE(node, origin, invertedDirection, maxDistance, entries);
+#endif
+	glm::vec3 scale(quantizedScale(node.exponent[0]), quantizedScale(node.exponent[1]), quantizedScale(node.exponent[2]));
+	int childMask = 0;
+	for (int child = 0; child < node.childCount; child++) {
+		glm::vec3 boundsMin = node.origin + glm::vec3(node.boundsMinX[child], node.boundsMinY[child], node.boundsMinZ[child]) * scale;
+		glm::vec3 boundsMax = node.origin + glm::vec3(node.boundsMaxX[child], node.boundsMaxY[child], node.boundsMaxZ[child]) * scale;
+		if (slabTest(boundsMin, boundsMax, origin, invertedDirection, maxDistance, entries[child])) childMask |= 1 << child;
+	}
+	return childMask;
+}
+
+void initialiseRayPacket(RayPacket& packet, const glm::vec3& origin, const glm::vec3* directions, int rayCount, float maxDistance) {
+	packet.origin = origin;
+	packet.rayCount = rayCount;
+	packet.inverseMin = glm::vec3(std::numeric_limits<float>::infinity());
+	packet.inverseMax = glm::vec3(-std::numeric_limits<float>::infinity());
+	glm::bvec3 anyNegative(false), anyPositive(false);
+	for (int ray = 0; ray < rayCount; ray++) {
+		packet.directionX[ray] = directions[ray].x;
+		packet.directionY[ray] = directions[ray].y;
+		packet.directionZ[ray] = directions[ray].z;
+		packet.closest[ray] = maxDistance;
+		packet.hits[ray] = { maxDistance, 0, 0, -1 };
+		glm::vec3 inverse = 1.0f / directions[ray];
+		packet.inverseMin = glm::min(packet.inverseMin, inverse);
+		packet.inverseMax = glm::max(packet.inverseMax, inverse);
+		for (int axis = 0; axis < 3; axis++) {
+			if (std::signbit(inverse[axis])) anyNegative[axis] = true;
+			else anyPositive[axis] = true;
+		}
+	}
+	packet.coherent = !glm::any(glm::bvec3(anyNegative.x && anyPositive.x, anyNegative.y && anyPositive.y, anyNegative.z && anyPositive.z));
+}
+
+void intersectTriangleRays(const TriangleRecord& record, RayPacket& packet) {
+	glm::vec3 SPVector = packet.origin - record.v0;
+	glm::vec3 SPCrossE0 = glm::cross(SPVector, record.e0);
+	float distanceNumerator = glm::dot(record.e1, SPCrossE0);
+	for (int ray = 0; ray < packet.rayCount; ray++) {
+		glm::vec3 direction(packet.directionX[ray], packet.directionY[ray], packet.directionZ[ray]);
+		glm::vec3 directionCrossE1 = glm::cross(direction, record.e1);
+		float determinant = glm::dot(record.e0, directionCrossE1);
+		if (glm::abs(determinant) < PARALLEL_EPSILON) continue;
+		float inverseDeterminant = 1.0f / determinant;
+		float u = glm::dot(SPVector, directionCrossE1) * inverseDeterminant;
+		float v = glm::dot(direction, SPCrossE0) * inverseDeterminant;
+		float t = distanceNumerator * inverseDeterminant;
+		if (u < 0.0 || u > 1.0 || v < 0.0 || u + v > 1.0 || t < 0) continue;
+		if (!acceptsHit(t, record.triangleIndex, packet.closest[ray], packet.hits[ray])) continue;
+		packet.hits[ray] = { t, u, v, record.triangleIndex };
+		packet.closest[ray] = t;
+	}
+}
+
+bool occludedTriangleRecords(const TriangleRecord* records, int count, const glm::vec3& origin, const glm::vec3& direction,
+	int excludeID, float maxDistance) {
+	for (int i = 0; i < count; i++) {
+		if (records[i].triangleIndex == excludeID) continue;
+		BVHHit candidate;
+		if (intersectTriangle(records[i], origin, direction, maxDistance, candidate)) return true;
+	}
+	return false;
+}
+
+bool occludedTrianglePacket(const TrianglePacket& packet, const glm::vec3& origin, const glm::vec3& direction,
+	int excludeID, float maxDistance) {
+#ifdef USE_X86_KERNELS
+	if (activeTriangleKernel != SCALAR_KERNEL) {
+		float t[PACKET_WIDTH], u[PACKET_WIDTH], v[PACKET_WIDTH];
+		int laneMask = testLanes(packet, origin, direction, maxDistance, t, u, v);
+		for (int lane = 0; lane < PACKET_WIDTH; lane++) {
+			if (packet.triangleIndex[lane] == excludeID) laneMask &= ~(1 << lane);
+		}
+		return laneMask != 0;
+	}
+#endif
+	return occludedPacketScalar(packet, origin, direction, excludeID, maxDistance);
+}
@@ -0,0 +1,116 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <cstdint>
+
+const int PACKET_WIDTH = 8;
+const int MAX_PACKET_RAYS = 64;
+const int WIDE_NODE_WIDTH = 4;
+
+// precomputed once per build or refit, so that a ray-triangle test needs no vertex lookups or matrix inversion
+struct alignas(16) TriangleRecord {
+	glm::vec3 v0;
+	int triangleIndex;
+	glm::vec3 e0; // v1 - v0
+	float padding0;
+	glm::vec3 e1; // v2 - v0
+	float padding1;
+};
+
+// the same data as up to 8 records, transposed so each component fills a SIMD register.
+// unused lanes have zero edges, which the kernels reject as parallel, and triangleIndex -1
+struct alignas(16) TrianglePacket {
+	float v0x[PACKET_WIDTH], v0y[PACKET_WIDTH], v0z[PACKET_WIDTH];
+	float e0x[PACKET_WIDTH], e0y[PACKET_WIDTH], e0z[PACKET_WIDTH];
+	float e1x[PACKET_WIDTH], e1y[PACKET_WIDTH], e1z[PACKET_WIDTH];
+	int triangleIndex[PACKET_WIDTH];
+};
+
+// a node of the collapsed 4-wide tree, holding the bounds of its children per axis so that one SIMD slab test covers them all.
+// children are packed into the first childCount slots
+struct alignas(16) WideBVHNode {
+	float boundsMinX[WIDE_NODE_WIDTH], boundsMinY[WIDE_NODE_WIDTH], boundsMinZ[WIDE_NODE_WIDTH];
+	float boundsMaxX[WIDE_NODE_WIDTH], boundsMaxY[WIDE_NODE_WIDTH], boundsMaxZ[WIDE_NODE_WIDTH];
+	int child[WIDE_NODE_WIDTH]; // wide node for interior children, first slot for leaves
+	int triangleCount[WIDE_NODE_WIDTH]; // 0 for interior children
+	int packet[WIDE_NODE_WIDTH]; // packet of leaf children
+	int childCount;
+};
+
+// the same node in 64 bytes, with child bounds stored as 8-bit offsets from origin in steps of 2^exponent on each axis.
+// bounds are rounded outwards, so decoded boxes always contain the exact ones
+struct alignas(16) QuantizedBVHNode {
+	glm::vec3 origin;
+	int8_t exponent[3];
+	uint8_t childCount;
+	uint8_t boundsMinX[WIDE_NODE_WIDTH], boundsMinY[WIDE_NODE_WIDTH], boundsMinZ[WIDE_NODE_WIDTH];
+	uint8_t boundsMaxX[WIDE_NODE_WIDTH], boundsMaxY[WIDE_NODE_WIDTH], boundsMaxZ[WIDE_NODE_WIDTH];
+	int child[WIDE_NODE_WIDTH]; // quantized node for interior children, packet for leaves
+	uint8_t triangleCount[WIDE_NODE_WIDTH]; // 0 for interior children
+	int padding;
+};
+
+struct BVHHit {
+	float distance;
+	float u; // distance along v1-v0 edge
+	float v; // distance along v2-v0 edge
+	int triangleIndex;
+};
+
+// up to an 8x8 tile of primary rays sharing the camera as origin, with directions stored per component.
+// closest and hits are per ray and are updated in place by the packet queries
+struct RayPacket {
+	glm::vec3 origin;
+	int rayCount;
+	float directionX[MAX_PACKET_RAYS], directionY[MAX_PACKET_RAYS], directionZ[MAX_PACKET_RAYS];
+	float closest[MAX_PACKET_RAYS];
+	BVHHit hits[MAX_PACKET_RAYS];
+	glm::vec3 inverseMin; // bounds of the inverted directions on each axis, which make up the packet's frustum
+	glm::vec3 inverseMax;
+	bool coherent; // false when the directions disagree in sign on an axis, so that the frustum is unbounded
+};
+
+enum TriangleKernel {
+	SCALAR_KERNEL,
+	SSE_KERNEL,
+	AVX2_KERNEL,
+};
+
+// picked once at startup from the CPU's features
+extern const TriangleKernel activeTriangleKernel;
+
+const char* getTriangleKernelName(TriangleKernel kernel);
+
+void fillTrianglePacket(TrianglePacket& packet, const TriangleRecord* records, int count);
+
+// the leaf kernels keep the closest hit no further than closest, ties going to the higher triangle index
+// as in a linear scan. they return true when hit and closest were updated
+bool intersectTriangleRecords(const TriangleRecord* records, int count, const glm::vec3& origin, const glm::vec3& direction,
+	int excludeID, float& closest, BVHHit& hit);
+
+bool intersectTrianglePacket(const TrianglePacket& packet, const glm::vec3& origin, const glm::vec3& direction,
+	int excludeID, float& closest, BVHHit& hit);
+
+// slab tests the ray against every child of the node, writing how far along the ray each hit child is entered.
+// returns a bit mask of the children that are hit no further than maxDistance
+int intersectWideNodeBounds(const WideBVHNode& node, const glm::vec3& origin, const glm::vec3& invertedDirection, float maxDistance,
+	float* entries);
+
+// decodes the child bounds of a quantized node and slab tests them like intersectWideNodeBounds
+int intersectQuantizedNodeBounds(const QuantizedBVHNode& node, const glm::vec3& origin, const glm::vec3& invertedDirection, float maxDistance,
+	float* entries);
+
+// the step of a quantized axis, built straight from the exponent bits
+float quantizedScale(int8_t exponent);
+
+// sets the directions and resets every ray to no hit within maxDistance
+void initialiseRayPacket(RayPacket& packet, const glm::vec3& origin, const glm::vec3* directions, int rayCount, float maxDistance);
+
+// tests one triangle against every ray of the packet, the terms that only depend on the shared origin are computed once
+void intersectTriangleRays(const TriangleRecord& record, RayPacket& packet);
+
+// any-hit versions for shadow rays, true as soon as one triangle is hit no further than maxDistance
+bool occludedTriangleRecords(const TriangleRecord* records, int count, const glm::vec3& origin, const glm::vec3& direction,
+	int excludeID, float maxDistance);
+
+bool occludedTrianglePacket(const TrianglePacket& packet, const glm::vec3& origin, const glm::vec3& direction,
+	int excludeID, float maxDistance);
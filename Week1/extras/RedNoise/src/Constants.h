@@ -1,7 +1,14 @@
 #pragma once
 
-const int WIDTH = 640;
-const int HEIGHT = 480;
+// resolution used when none is given on the command line
+const int DEFAULT_WIDTH = 640;
+const int DEFAULT_HEIGHT = 480;
+// side of the square tile of primary rays traced together, 2, 4 or 8 (at most 64 rays)
+const int RAY_PACKET_SIZE = 4;
+// rows per task handed to the thread pool, a multiple of RAY_PACKET_SIZE
+const int BAND_HEIGHT = 16;
+// longest the main loop sleeps on the event queue, when it has nothing to draw, before looking again
+const int IDLE_WAIT_MILLISECONDS = 100;
 enum RenderType {
 	POINTCLOUD,
 	WIREFRAME,
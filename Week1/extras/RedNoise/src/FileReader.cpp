@@ -8,7 +8,6 @@ void FileReader::addFileData(PolygonData& objects, std::ifstream& valid_filestre
 	std::string line;
 	Colour currentColor;
 	int currentVertex = 0;
-	glm::vec3 translation = { 0,0,0 };
 	float reflectivity = 0;
 	std::string name;
 	while (std::getline(valid_filestream, line)) {
@@ -17,9 +16,9 @@ void FileReader::addFileData(PolygonData& objects, std::ifstream& valid_filestre
 		std::string identifier = tokens[0];
 		if (identifier == "v") {
 			glm::vec3 position = {
-				std::stof(tokens[1]) * scaleFactor + translation.x,
-				std::stof(tokens[2]) * scaleFactor + translation.y,
-				std::stof(tokens[3]) * scaleFactor + translation.z
+				std::stof(tokens[1]) * scaleFactor,
+				std::stof(tokens[2]) * scaleFactor,
+				std::stof(tokens[3]) * scaleFactor
 			};
 			GouraudVertex vertex(position, currentColor);
 			objects.loadedVertices.push_back(vertex);
@@ -58,10 +57,7 @@ void FileReader::addFileData(PolygonData& objects, std::ifstream& valid_filestre
 		}
 		else if (identifier == "o") {
 			name = tokens[1];
-			if (name == "red_sphere") {
-				translation = { -0.5, -1.2, 0.3 };
-			}
-			else if (tokens[1] == "tall_box") {
+			if (tokens[1] == "tall_box") {
 				reflectivity = 0.8;
 			}
 		}
@@ -69,7 +65,6 @@ void FileReader::addFileData(PolygonData& objects, std::ifstream& valid_filestre
 			currentColor = supportedColors[tokens[1]];
 		}
 		else {
-			translation = { 0,0,0 };
 			reflectivity = 0;
 		}
 	}
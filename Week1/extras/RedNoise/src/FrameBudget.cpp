@@ -0,0 +1,26 @@
+#include "FrameBudget.h"
+#include <glm/glm.hpp>
+
+FrameBudget::FrameBudget(float targetMilliseconds) : renderScale(1), enabled(false), targetMilliseconds(targetMilliseconds) {}
+
+float FrameBudget::getRenderScale() const {
+	return renderScale;
+}
+
+RenderTarget FrameBudget::getInternalTarget(const RenderTarget& window) const {
+	int width = glm::max(1, int(glm::round(window.width * renderScale)));
+	int height = glm::max(1, int(glm::round(window.height * renderScale)));
+	return RenderTarget(width, height, window.workerCount);
+}
+
+void FrameBudget::update(float frameMilliseconds) {
+	if (frameMilliseconds <= 0) return;
+	// frame time follows the pixel count, which goes with the square of the scale
+	float ideal = renderScale * glm::sqrt(targetMilliseconds / frameMilliseconds);
+	// only go halfway there, and in whole steps, so that noisy timings do not resize every frame. a frame over
+	// budget always gives up at least a step, one under it has to be a clear half step under to grow
+	float damped = glm::mix(renderScale, ideal, 0.5f);
+	float steps = damped / RENDER_SCALE_STEP;
+	float stepped = (frameMilliseconds > targetMilliseconds ? glm::floor(steps) : glm::round(steps)) * RENDER_SCALE_STEP;
+	renderScale = glm::clamp(stepped, MIN_RENDER_SCALE, 1.0f);
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include "RenderTarget.h"
+
+// internal resolution is a fraction of the window's, in steps of this size
+const float RENDER_SCALE_STEP = 1.0f / 16;
+const float MIN_RENDER_SCALE = 0.25f;
+
+// picks the resolution frames are ray traced at so that they take about targetMilliseconds, by scaling
+// the window's resolution down when frames run long and back up when they come in early
+class FrameBudget {
+private:
+	float renderScale; // fraction of the window's width and height
+
+public:
+	bool enabled;
+	float targetMilliseconds;
+
+	explicit FrameBudget(float targetMilliseconds);
+
+	float getRenderScale() const;
+
+	// the target to trace at this frame, framed the same as window
+	RenderTarget getInternalTarget(const RenderTarget& window) const;
+
+	// feeds back how long the last frame took on the pipeline, from its first stage to the end of the upsample.
+	// presenting it on the main thread is not included
+	void update(float frameMilliseconds);
+};
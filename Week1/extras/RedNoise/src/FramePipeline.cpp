@@ -0,0 +1,85 @@
+#include "FramePipeline.h"
+
+FramePipeline::FramePipeline(std::function<void()> onFrameLanded) : nextBuffer(0), frameEpoch(0), tracedBuffer(0), inFlight(false),
+	traced(false), stopping(false), onFrameLanded(std::move(onFrameLanded)), pipelineThread(&FramePipeline::pipelineLoop, this) {}
+
+FramePipeline::~FramePipeline() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	condition.notify_all();
+	pipelineThread.join();
+}
+
+void FramePipeline::pipelineLoop() {
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true) {
+		// a frame submitted before stopping is still traced, so that nothing it refers to is left waiting on it
+		condition.wait(lock, [this] { return stopping || pendingTrace; });
+		if (!pendingTrace) return;
+		std::function<void(Frame&)> trace = std::move(pendingTrace);
+		pendingTrace = nullptr;
+		Frame& buffer = buffers[tracedBuffer];
+		lock.unlock();
+
+		std::exception_ptr error;
+		try {
+			trace(buffer);
+		}
+		catch (...) {
+			error = std::current_exception();
+		}
+
+		lock.lock();
+		traceError = error;
+		traced = true;
+		condition.notify_all();
+		if (onFrameLanded) {
+			lock.unlock();
+			onFrameLanded();
+			lock.lock();
+		}
+	}
+}
+
+bool FramePipeline::isBusy() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return inFlight;
+}
+
+bool FramePipeline::isReady() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return inFlight && traced;
+}
+
+void FramePipeline::submit(unsigned epoch, std::function<void(Frame&)> trace) {
+	if (isBusy()) finish();
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		tracedBuffer = nextBuffer;
+		pendingTrace = std::move(trace);
+		inFlight = true;
+		traced = false;
+	}
+	condition.notify_all();
+	frameEpoch = epoch;
+	nextBuffer = 1 - nextBuffer;
+}
+
+FramePipeline::Frame& FramePipeline::finish() {
+	std::unique_lock<std::mutex> lock(mutex);
+	condition.wait(lock, [this] { return traced; });
+	inFlight = false;
+	traced = false;
+	std::exception_ptr error = traceError;
+	traceError = nullptr;
+	lock.unlock();
+	// rethrows anything the trace threw
+	if (error) std::rethrow_exception(error);
+	return buffers[tracedBuffer];
+}
+
+unsigned FramePipeline::getFrameEpoch() const {
+	return frameEpoch;
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <vector>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <cstdint>
+
+// overlaps tracing the next frame with filtering and presenting the last one. frames are traced on one long-lived
+// pipeline thread into two alternating colour buffers, and at most one frame is in flight at a time
+class FramePipeline {
+public:
+	using Frame = std::vector<std::vector<uint32_t>>;
+
+private:
+	Frame buffers[2];
+	int nextBuffer; // buffer the next submitted frame is traced into
+	unsigned frameEpoch; // input epoch the frame last submitted was started for
+	int tracedBuffer; // buffer of the frame last submitted
+
+	// shared with the pipeline thread under mutex
+	std::function<void(Frame&)> pendingTrace; // submitted, not yet picked up
+	bool inFlight; // submitted and not yet finished
+	bool traced; // the frame in flight has been traced
+	bool stopping;
+	std::exception_ptr traceError; // whatever the trace of the frame in flight threw
+	std::function<void()> onFrameLanded;
+	mutable std::mutex mutex;
+	std::condition_variable condition;
+	std::thread pipelineThread; // last, so that everything it reads is set up before it starts
+
+	void pipelineLoop();
+
+public:
+	// onFrameLanded is called on the pipeline thread each time a frame has been traced, once isReady holds
+	explicit FramePipeline(std::function<void()> onFrameLanded = nullptr);
+	// waits for the frame in flight before stopping the pipeline thread
+	~FramePipeline();
+
+	bool isBusy() const;
+
+	// true once the frame in flight has finished, so that finish will not block
+	bool isReady() const;
+
+	// starts trace(buffer) on the pipeline thread for the given input epoch. a frame still in flight is waited for
+	// and dropped first
+	void submit(unsigned epoch, std::function<void(Frame&)> trace);
+
+	// waits for the frame in flight and returns it. a buffer handed out stays untouched until the frame after
+	// next is submitted
+	Frame& finish();
+
+	unsigned getFrameEpoch() const;
+};
@@ -0,0 +1,115 @@
+#include "IrradianceCache.h"
+
+namespace {
+	// largest error, distance relative to the radius plus normal divergence, at which a record still counts
+	const float TOLERANCE = 0.5f;
+	// how far a record may lie in front of a point, relative to its radius, before it is taken to see something else
+	const float FRONT_TOLERANCE = 0.05f;
+	const int MAX_DEPTH = 16;
+
+	// Ward's error of using record at position, negative when it does not apply at all
+	float recordError(const IrradianceRecord& record, glm::vec3 position, glm::vec3 normal) {
+		glm::vec3 offset = position - record.position;
+		if (glm::dot(offset, record.normal + normal) * 0.5f < -FRONT_TOLERANCE * record.radius) return -1;
+		return glm::length(offset) / record.radius + glm::sqrt(glm::max(1 - glm::dot(record.normal, normal), 0.0f));
+	}
+
+	// adds the record's extrapolated visibility, weighted to fall to 0 at the tolerance so that no seams show where it stops counting
+	void accumulate(const IrradianceRecord& record, glm::vec3 position, glm::vec3 normal, float& weightedSum, float& weightSum) {
+		float error = recordError(record, position, normal);
+		if (error < 0 || error >= TOLERANCE) return;
+		float weight = 1 - error / TOLERANCE;
+		weightedSum += weight * (record.visibility + glm::dot(record.gradient, position - record.position));
+		weightSum += weight;
+	}
+}
+
+void IrradianceCache::validate(PolygonData& objects, glm::vec3 light) {
+	if (computed && light == lightOrigin && objects.accelerator.version == sceneVersion) return;
+	computed = true;
+	lightOrigin = light;
+	sceneVersion = objects.accelerator.version;
+	records.clear();
+	{
+		std::lock_guard<std::mutex> lock(pendingMutex);
+		pending.clear();
+	}
+	nodes.assign(1, OctreeNode());
+	std::fill(nodes[0].children, nodes[0].children + 8, -1);
+	// a cube around the whole scene, padded for the offset the points are sampled at
+	const std::vector<BVHNode>& topNodes = objects.accelerator.topLevel.nodes;
+	glm::vec3 sceneMin = topNodes.empty() ? glm::vec3(0) : topNodes[0].boundsMin;
+	glm::vec3 sceneMax = topNodes.empty() ? glm::vec3(0) : topNodes[0].boundsMax;
+	glm::vec3 extent = sceneMax - sceneMin;
+	boundsSize = glm::max(glm::max(extent.x, extent.y), extent.z) + 0.1f;
+	boundsMin = sceneMin - 0.05f;
+}
+
+void IrradianceCache::insert(int recordIndex) {
+	const IrradianceRecord& record = records[recordIndex];
+	float reach = TOLERANCE * record.radius;
+	glm::vec3 reachMin = record.position - reach;
+	glm::vec3 reachMax = record.position + reach;
+	// nodes are visited with their corner and size, descending until the octants get smaller than the record's reach
+	struct Visit {
+		int node;
+		glm::vec3 corner;
+		float size;
+		int depth;
+	};
+	std::vector<Visit> stack = { { 0, boundsMin, boundsSize, 0 } };
+	while (!stack.empty()) {
+		Visit visit = stack.back();
+		stack.pop_back();
+		float half = visit.size * 0.5f;
+		if (half < 2 * reach || visit.depth == MAX_DEPTH) {
+			nodes[visit.node].records.push_back(recordIndex);
+			continue;
+		}
+		for (int octant = 0; octant < 8; octant++) {
+			glm::vec3 corner = visit.corner + half * glm::vec3(octant & 1, (octant >> 1) & 1, (octant >> 2) & 1);
+			if (glm::any(glm::lessThan(corner + half, reachMin)) || glm::any(glm::greaterThan(corner, reachMax))) continue;
+			if (nodes[visit.node].children[octant] == -1) {
+				nodes[visit.node].children[octant] = nodes.size();
+				nodes.push_back(OctreeNode());
+				std::fill(nodes.back().children, nodes.back().children + 8, -1);
+			}
+			stack.push_back({ nodes[visit.node].children[octant], corner, half, visit.depth + 1 });
+		}
+	}
+}
+
+bool IrradianceCache::lookup(glm::vec3 position, glm::vec3 normal, const std::vector<IrradianceRecord>& extraRecords, float& visibility) const {
+	float weightedSum = 0;
+	float weightSum = 0;
+	// every record that reaches position sits in one of the nodes along the path down to it
+	int node = nodes.empty() ? -1 : 0;
+	glm::vec3 corner = boundsMin;
+	float size = boundsSize;
+	while (node != -1) {
+		for (int recordIndex : nodes[node].records) accumulate(records[recordIndex], position, normal, weightedSum, weightSum);
+		size *= 0.5f;
+		glm::bvec3 upper = glm::greaterThanEqual(position, corner + size);
+		corner += size * glm::vec3(upper);
+		node = nodes[node].children[int(upper.x) | int(upper.y) << 1 | int(upper.z) << 2];
+	}
+	for (const IrradianceRecord& record : extraRecords) accumulate(record, position, normal, weightedSum, weightSum);
+	if (weightSum <= 0) return false;
+	visibility = glm::clamp(weightedSum / weightSum, 0.0f, 1.0f);
+	return true;
+}
+
+void IrradianceCache::add(const std::vector<IrradianceRecord>& tileRecords) {
+	if (tileRecords.empty()) return;
+	std::lock_guard<std::mutex> lock(pendingMutex);
+	pending.insert(pending.end(), tileRecords.begin(), tileRecords.end());
+}
+
+void IrradianceCache::commit() {
+	std::lock_guard<std::mutex> lock(pendingMutex);
+	for (const IrradianceRecord& record : pending) {
+		records.push_back(record);
+		insert(records.size() - 1);
+	}
+	pending.clear();
+}
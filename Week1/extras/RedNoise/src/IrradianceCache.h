@@ -0,0 +1,54 @@
+#pragma once
+#include <vector>
+#include <mutex>
+#include <glm/glm.hpp>
+#include <PolygonData.h>
+
+// soft shadow visibility of the light sampled at one surface point
+struct IrradianceRecord {
+	glm::vec3 position;
+	glm::vec3 normal; // face normal of the triangle it was sampled on
+	float visibility; // fraction of the light's samples that reached it
+	glm::vec3 gradient; // change of visibility per unit moved along the surface
+	float radius; // distance over which the visibility is expected to hold
+};
+
+// Ward style cache of soft shadow visibility. records are sampled at sparse points and every other hit close enough
+// to them, by distance relative to their radius and by normal, is given their gradient extrapolated and weighted
+// average instead of tracing rays of its own. records are kept in world space, so they serve every frame and view
+// until the light or the visible geometry moves
+class IrradianceCache {
+private:
+	// a cube of space, records are kept in every node of about their size their validity sphere overlaps
+	struct OctreeNode {
+		int children[8]; // -1 where the octant holds nothing yet
+		std::vector<int> records;
+	};
+
+	std::vector<OctreeNode> nodes; // root first
+	glm::vec3 boundsMin;
+	float boundsSize = 0;
+	bool computed = false;
+	glm::vec3 lightOrigin;
+	unsigned sceneVersion = 0;
+	std::mutex pendingMutex;
+	std::vector<IrradianceRecord> pending; // sampled by the frame in flight, not in the octree yet
+
+	void insert(int recordIndex);
+
+public:
+	std::vector<IrradianceRecord> records;
+
+	// forgets every record unless they were sampled for this light and the visible geometry of objects
+	void validate(PolygonData& objects, glm::vec3 lightOrigin);
+
+	// visibility interpolated from the records valid at position, including extraRecords that have not been
+	// committed yet. false when none of them is
+	bool lookup(glm::vec3 position, glm::vec3 normal, const std::vector<IrradianceRecord>& extraRecords, float& visibility) const;
+
+	// queues records sampled by a tile, safe to call from every worker while lookups run
+	void add(const std::vector<IrradianceRecord>& tileRecords);
+
+	// moves the queued records into the octree, must not run while lookups do
+	void commit();
+};
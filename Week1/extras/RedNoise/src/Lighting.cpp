@@ -4,7 +4,7 @@ Lighting lighting(true, false, false, false, false, false);
 
 Lighting::Lighting(bool initAmb, bool initShadow, bool initDiffuse, bool initSpec, bool initPhong, bool initSoft) :
 	useShadow(initShadow), useProximity(initDiffuse), useIncidence(initDiffuse), useSpecular(initSpec),
-	useAmbience(initAmb), usePhong(initPhong), useSoftShadow(initSoft), useReflections(false), useFilter(false) {}
+	useAmbience(initAmb), usePhong(initPhong), useSoftShadow(initSoft), useReflections(false), useFilter(false), useVertexShadows(false), useIrradianceCache(false) {}
 
 glm::vec3 Lighting::sampleLightPosition(const glm::vec3 lightPosition, float lightRadius) {
 	std::normal_distribution<float> distribution(0.0f, lightRadius);
@@ -14,3 +14,13 @@ glm::vec3 Lighting::sampleLightPosition(const glm::vec3 lightPosition, float lig
 	return lightPosition + offset;
 }
 
+bool Lighting::operator==(const Lighting& other) const {
+	return useShadow == other.useShadow && useProximity == other.useProximity && useIncidence == other.useIncidence &&
+		useSpecular == other.useSpecular && useAmbience == other.useAmbience && usePhong == other.usePhong &&
+		useSoftShadow == other.useSoftShadow && useReflections == other.useReflections && useFilter == other.useFilter &&
+		useVertexShadows == other.useVertexShadows && useIrradianceCache == other.useIrradianceCache;
+}
+
+bool Lighting::operator!=(const Lighting& other) const {
+	return !(*this == other);
+}
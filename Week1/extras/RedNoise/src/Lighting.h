@@ -13,10 +13,15 @@ struct Lighting{
 	bool useSoftShadow;
 	bool useReflections;
 	bool useFilter;
+	bool useVertexShadows; // Gouraud shading takes hard shadows from per-vertex light visibility where it can
+	bool useIrradianceCache; // soft shadows are interpolated between sparse cached samples
 
 	Lighting(bool initAmb, bool initShadow, bool initDiffuse, bool initSpec, bool initPhong, bool initSoft);
 
 	static glm::vec3 sampleLightPosition(const glm::vec3 lightPosition, float lightRadius);
+
+	bool operator==(const Lighting& other) const;
+	bool operator!=(const Lighting& other) const;
 };
 
 extern Lighting lighting;
\ No newline at end of file
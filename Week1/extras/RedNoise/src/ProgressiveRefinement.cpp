@@ -0,0 +1,35 @@
+#include "ProgressiveRefinement.h"
+
+ProgressiveRefinement::ProgressiveRefinement() : step(0), enabled(true) {}
+
+void ProgressiveRefinement::restart() {
+	step = 0;
+}
+
+bool ProgressiveRefinement::isStarting() const {
+	return step == 0;
+}
+
+bool ProgressiveRefinement::isComplete() const {
+	return step == 1;
+}
+
+int ProgressiveRefinement::getNextStep() const {
+	return step == 0 ? COARSEST_STEP : step / 2;
+}
+
+void ProgressiveRefinement::refine(const RenderTarget& target, std::vector<std::vector<uint32_t>>& frame, const std::function<void(std::vector<std::vector<uint32_t>>&, int, bool)>& tracePass) {
+	if (!isComplete()) {
+		int nextStep = getNextStep();
+		target.fitBuffer(samples, 0u);
+		tracePass(samples, nextStep, step != 0);
+		step = nextStep;
+	}
+
+	// every pixel shows the sample at the corner of the step-sized block it lies in
+	target.fitBuffer(frame, 0u);
+	for (int y = 0; y < target.height; y++) {
+		const std::vector<uint32_t>& sampleRow = samples[y - y % step];
+		for (int x = 0; x < target.width; x++) frame[y][x] = sampleRow[x - x % step];
+	}
+}
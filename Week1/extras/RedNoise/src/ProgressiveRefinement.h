@@ -0,0 +1,34 @@
+#pragma once
+#include <vector>
+#include <functional>
+#include <cstdint>
+#include "RenderTarget.h"
+
+// spacing of the samples in the first pass after a restart, halved every pass down to 1
+const int COARSEST_STEP = 8;
+
+// traces a frame in passes of increasing resolution, so that a moving camera gets a coarse image quickly
+// and a still one converges to the full frame. every pass keeps the samples of the one before it
+class ProgressiveRefinement {
+private:
+	int step; // spacing of the samples traced so far, 0 before the first pass
+	std::vector<std::vector<uint32_t>> samples;
+
+public:
+	bool enabled;
+
+	ProgressiveRefinement();
+
+	// drops the traced samples, the next pass starts from the coarsest step again
+	void restart();
+
+	bool isStarting() const;
+	bool isComplete() const;
+
+	// spacing the next pass will trace at
+	int getNextStep() const;
+
+	// runs the next pass through tracePass(samples, step, skipCoarser), then writes the samples into frame with
+	// each one widened over the pixels not traced yet
+	void refine(const RenderTarget& target, std::vector<std::vector<uint32_t>>& frame, const std::function<void(std::vector<std::vector<uint32_t>>&, int, bool)>& tracePass);
+};
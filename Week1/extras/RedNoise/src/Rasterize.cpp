@@ -93,12 +93,12 @@ void Rasterize::drawRasterizedTriangle(DrawingWindow& window, CanvasTriangle tri
 	// rasterize top triangle
 	uint32_t pixelColor = (255 << 24) + (int(color.red) << 16) + (int(color.green) << 8) + int(color.blue);
 	for (int y = std::floor(vertices[0].y), i = 0; y < std::floor(vertices[1].y); y++, i++) {
-		if (y >= HEIGHT || y < 0) continue;
+		if (y >= int(window.height) || y < 0) continue;
 		int xStart = std::floor(interpolations.topLeft[i]);
 		int xEnd = std::ceil(interpolations.topRight[i]);
 		if (std::abs(xStart - xEnd) < 2) continue;
 		for (int x = xStart; x < xEnd; x++) {
-			if (x < 0 || x >= WIDTH) continue;
+			if (x < 0 || x >= int(window.width)) continue;
 			// use barycentric ratios to calculate zIndex
 			BarycentricCoordinates ratios = barycentric(vertices, glm::vec2(x, y));
 			float zIndex = 1 / (ratios.A * vertices[0].depth + ratios.B * vertices[1].depth + ratios.C * vertices[2].depth);
@@ -109,12 +109,12 @@ void Rasterize::drawRasterizedTriangle(DrawingWindow& window, CanvasTriangle tri
 	}
 	// rasterize bottom triangle
 	for (int y = std::floor(vertices[1].y), i = 0; y < std::floor(vertices[2].y); y++, i++) {
-		if (y >= HEIGHT || y < 0) continue;
+		if (y >= int(window.height) || y < 0) continue;
 		int xStart = std::floor(interpolations.leftBottom[i]);
 		int xEnd = std::ceil(interpolations.rightBottom[i]);
 		if (std::abs(xStart - xEnd) < 2) continue;
 		for (int x = xStart; x < xEnd; x++) {
-			if (x < 0 || x >= WIDTH) continue;
+			if (x < 0 || x >= int(window.width)) continue;
 			// interpolate z values
 			BarycentricCoordinates ratios = barycentric(vertices, glm::vec2(x, y));
 			float zIndex = 1 / (ratios.A * vertices[0].depth + ratios.B * vertices[1].depth + ratios.C * vertices[2].depth);
@@ -135,12 +135,12 @@ void Rasterize::drawRasterizedTriangle(DrawingWindow& window, CanvasTriangle tri
 
 	// rasterize top triangle with textures
 	for (int y = std::floor(canvasVertices[0].y), i = 0; y < std::floor(canvasVertices[1].y); y++, i++) {
-		if (y >= HEIGHT || y < 0) continue;
+		if (y >= int(window.height) || y < 0) continue;
 		int xStart = std::floor(interpolations.topLeft[i]);
 		int xEnd = std::ceil(interpolations.topRight[i]);
 		if (std::abs(xStart - xEnd) < 2) continue;
 		for (int x = xStart; x < xEnd; x++) {
-			if (x < 0 || x >= WIDTH) continue;
+			if (x < 0 || x >= int(window.width)) continue;
 			glm::vec2 currentVertex(x, y);
 			BarycentricCoordinates ratios = barycentric(canvasVertices, currentVertex);
 			float zIndex = 1 / (ratios.A * canvasVertices[0].depth + ratios.B * canvasVertices[1].depth + ratios.C * canvasVertices[2].depth);
@@ -153,12 +153,12 @@ void Rasterize::drawRasterizedTriangle(DrawingWindow& window, CanvasTriangle tri
 
 	// rasterize bottom triangle with textures
 	for (int y = std::floor(canvasVertices[1].y), i = 0; y < std::floor(canvasVertices[2].y); y++, i++) {
-		if (y >= HEIGHT || y < 0) continue;
+		if (y >= int(window.height) || y < 0) continue;
 		int xStart = std::floor(interpolations.leftBottom[i]);
 		int xEnd = std::ceil(interpolations.rightBottom[i]);
 		if (std::abs(xStart - xEnd) < 2) continue;
 		for (int x = xStart; x < xEnd; x++) {
-			if (x < 0 || x >= WIDTH) continue;
+			if (x < 0 || x >= int(window.width)) continue;
 			glm::vec2 currentVertex(x, y);
 			BarycentricCoordinates ratios = barycentric(canvasVertices, currentVertex);
 			uint32_t pixelTexture = getTexture(ratios, canvasVertices, textures);
@@ -1,10 +1,45 @@
 #include "Raytrace.h"
+#include "ThreadPool.h"
+#include "Reprojection.h"
+#include "IrradianceCache.h"
+
+// every x86-64 cpu has sse2, so the vertex lighting takes the sse path whenever it is compiled in
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__)
+#define USE_SSE_LIGHTING
+#include <immintrin.h>
+#endif
 
 //Colour globalAmbientColor(70, 20, 20);
 Colour globalAmbientColor(20, 20, 20);
 Colour globalLightColor(255, 255, 255);
 
 namespace {
+	// shadow rays per pixel towards random points on the light, increase for better shadows, worse performance
+	const int SOFT_SHADOW_SAMPLES = 40;
+	const float LIGHT_RADIUS = 0.1f;
+	// vertices whose normal is within this cosine of a triangle's count as smooth for its light visibility
+	const float SMOOTH_VERTEX_COSINE = 0.99f;
+	// fraction of the way to the light a triangle's pyramid starts at, so that neighbours touching its edges do not
+	// count as reaching into it
+	const float PYRAMID_BASE_LIFT = 0.001f;
+	// when accumulating over frames, a pixel gets this many more per frame until it has ACCUMULATED_SAMPLES
+	const int SAMPLES_PER_FRAME = 4;
+	const int ACCUMULATED_SAMPLES = 4 * SOFT_SHADOW_SAMPLES;
+	// rays an irradiance record casts from its point, and again from a step along each tangent for its gradient
+	const int IRRADIANCE_SAMPLES = 64;
+	const float GRADIENT_STEP = 0.02f;
+	// a record's radius is how far its gradient takes the visibility by MAX_VISIBILITY_CHANGE, within these bounds
+	const float MAX_VISIBILITY_CHANGE = 0.3f;
+	const float MIN_RECORD_RADIUS = 0.02f;
+	const float MAX_RECORD_RADIUS = 0.2f;
+	// instance trees come from the BVH builder, whose depth cap keeps a descent through one within this
+	const int MAX_STACK_SIZE = 64;
+
+	// specularity to the power of the shininess, 128, by squaring
+	float applyShininess(float specularity) {
+		for (int i = 0; i < 7; i++) specularity *= specularity;
+		return specularity;
+	}
 
 	glm::vec2 getLightAttributes(glm::vec3& normal, glm::vec3& lightPosition, glm::vec3& start, glm::vec3& position) {
 		glm::vec2 output;
@@ -28,98 +63,36 @@ namespace {
 		if (lighting.useSpecular) {
 			glm::vec3 reflection = glm::reflect(-lightDirection, normal);
 			float specularity = glm::max(glm::dot(reflection, glm::normalize(start - position)), 0.0f);
-			float shininess = 128;
-			specularComponent = glm::pow(specularity, shininess);
+			specularComponent = applyShininess(specularity);
 		}
 		return { diffuseComponent, specularComponent };
 	}
 
-	bool intersectsBoundingBox(ModelTriangle& triangle, const glm::vec3 invertedDir, const glm::vec3 origin) {
-		// AABB bounding box intersection algorithm
-		glm::vec3 rayMin = (triangle.boundingMinMax.first - origin) * invertedDir;
-		glm::vec3 rayMax = (triangle.boundingMinMax.second - origin) * invertedDir;
-		for (int i = 0; i < 3; i++) {
-			if (invertedDir[i] < 0.0f) std::swap(rayMin[i], rayMax[i]);
-		}
-		float finalEntry = glm::max(rayMin.x, rayMin.y, rayMin.z);
-		float finalExit = glm::min(rayMax.x, rayMax.y, rayMax.z);
-		if (finalExit < finalEntry || finalExit < 0) return false;
-		return true;
-	}
-
-	RayTriangleIntersection getClosestValidIntersection(glm::vec3& startPosition, glm::vec3& rayDirection, PolygonData& objects, std::set<std::string>& hiddenObjects, int excludeID = -1, float lightDistance = std::numeric_limits<float>::max()) {
+	RayTriangleIntersection getClosestValidIntersection(glm::vec3& startPosition, glm::vec3& rayDirection, PolygonData& objects, int excludeID = -1, float lightDistance = std::numeric_limits<float>::max()) {
 		RayTriangleIntersection closest;
 		closest.distanceFromCamera = std::numeric_limits<float>::max();
 		closest.triangleIndex = -1;
-		glm::vec3 invertedDirection = 1.0f / rayDirection;
-		for (int triangleIndex = 0; triangleIndex < objects.loadedTriangles.size(); triangleIndex++) {
-			if (triangleIndex == excludeID) continue;
-			if (hiddenObjects.find(objects.loadedTriangles[triangleIndex].objectName) != hiddenObjects.end()) continue;
-			if (!intersectsBoundingBox(objects.loadedTriangles[triangleIndex], invertedDirection, startPosition)) {
-				continue;
-			}
-			glm::vec3 e0 = objects.getTriangleVertexPosition(triangleIndex, 1) - objects.getTriangleVertexPosition(triangleIndex, 0);
-			glm::vec3 e1 = objects.getTriangleVertexPosition(triangleIndex, 2) - objects.getTriangleVertexPosition(triangleIndex, 0);
-			glm::vec3 SPVector = startPosition - objects.getTriangleVertexPosition(triangleIndex, 0);
-			glm::mat3 DEMatrix(-rayDirection, e0, e1);
-			glm::vec3 possibleSolution = glm::inverse(DEMatrix) * SPVector;
-			float t = possibleSolution.x; // distance from camera
-			float u = possibleSolution.y; // distance along v1-v0 edge
-			float v = possibleSolution.z; // distance along v2-v0 edge
-			
-			// assert validity check
-			if (u >= 0.0 && u <= 1.0 && v >= 0.0 && v <= 1.0 && u + v <= 1.0) {
-				// get the closest triangle to camera
-				if (t > lightDistance || t > closest.distanceFromCamera || t < 0) {
-					continue;
-				}
-				closest.distanceFromCamera = t;
-				closest.triangleIndex = triangleIndex;
-				closest.intersectedTriangle = objects.loadedTriangles[triangleIndex];
-				closest.intersectionPoint = startPosition + t * rayDirection;
-				closest.barycentric = glm::vec3{ u, v, 1 - (u + v) };
-			}
+		BVHHit hit;
+		if (!objects.accelerator.intersect(startPosition, rayDirection, hit, excludeID, lightDistance)) {
+			return closest;
 		}
+		closest.distanceFromCamera = hit.distance;
+		closest.triangleIndex = hit.triangleIndex;
+		closest.intersectedTriangle = objects.loadedTriangles[hit.triangleIndex];
+		closest.intersectionPoint = startPosition + hit.distance * rayDirection;
+		closest.barycentric = glm::vec3{ hit.u, hit.v, 1 - (hit.u + hit.v) };
 		return closest;
 	}
 
 	// inverse of getCanvasIntersection
-	glm::vec3 getCanvasPosition(Camera& camera, int x, int y, glm::mat3& inverseViewMatrix) {
-		int scaleFactor = 90;
-		float focalLength = 2.0f;
-		x = WIDTH - x;
-		float realX = ((x - WIDTH / 2) / (scaleFactor * focalLength));
-		float realY = ((y - HEIGHT / 2) / (scaleFactor * focalLength));
-		glm::vec3 displacement = glm::vec3(realX, realY, focalLength) * inverseViewMatrix;
+	glm::vec3 getCanvasPosition(Camera& camera, const RenderTarget& target, int x, int y, glm::mat3& inverseViewMatrix) {
+		x = target.width - x;
+		float realX = ((x - target.width / 2) / target.scale);
+		float realY = ((y - target.height / 2) / target.scale);
+		glm::vec3 displacement = glm::vec3(realX, realY, target.focalLength) * inverseViewMatrix;
 		return camera.cameraPosition + displacement;
 	}
 	
-	float getSoftShadow(PolygonData& objects, RayTriangleIntersection& initialIntersection, glm::vec3& lightPosition, glm::vec3 cameraPosition, std::set<std::string>& hiddenObjects) {
-		// check they're on the same side
-		glm::vec3 normal = initialIntersection.intersectedTriangle.normal;
-		glm::vec3 offset = initialIntersection.intersectionPoint + 0.01f * normal;
-		glm::vec3 cameraDirection = glm::normalize(cameraPosition - offset); // point to camera
-
-		float cameraNormalAngle = glm::dot(normal, cameraDirection);
-		if (cameraNormalAngle < 0) return 1;
-
-		int samples = 40; // increase for better shadows, worse performance
-		float lightRadius = 0.1;
-		glm::vec3 offsetPoint = initialIntersection.intersectionPoint + 
-			0.01f * initialIntersection.intersectedTriangle.normal;
-		int hits = 0;
-		for (int i = 0; i < samples; i++) {
-			glm::vec3 sampledLight = Lighting::sampleLightPosition(lightPosition, lightRadius);
-			glm::vec3 direction = glm::normalize(sampledLight - offsetPoint);
-			float lightDistance = glm::length(sampledLight - offsetPoint);
-			RayTriangleIntersection shadowIntersection = 
-				getClosestValidIntersection(offsetPoint, direction, objects, hiddenObjects, initialIntersection.triangleIndex, lightDistance);
-			if (shadowIntersection.triangleIndex == -1) hits += 1;
-		}
-
-		return float(hits) / samples;
-	}
-
 	glm::vec3 getPhongNormal(PolygonData& objects, RayTriangleIntersection& intersection) {
 		std::array<int, 3> vertices = intersection.intersectedTriangle.vertices;
 		glm::vec3 barycentric = intersection.barycentric;
@@ -129,13 +102,6 @@ namespace {
 		return interpolatedNormal;
 	}
 
-	glm::vec2 calculatePhongComponents(PolygonData& objects, RayTriangleIntersection& intersection, glm::vec3 lightPosition, glm::vec3 start) {
-		// interpolate the normal by the pixel
-		glm::vec3 interpolatedNormal = getPhongNormal(objects, intersection);
-		glm::vec3 pixelCoordinates = intersection.intersectionPoint;
-		return getLightAttributes(interpolatedNormal, lightPosition, start, pixelCoordinates);
-	}
-
 	std::vector<glm::vec2> calculateGouraudComponents(PolygonData& objects, RayTriangleIntersection& intersection) {
 		int triangleIndex = intersection.triangleIndex;
 		glm::vec3 barycentric = intersection.barycentric;
@@ -172,44 +138,467 @@ namespace {
 		]);
 	}
 
-	std::pair<Colour, RayTriangleIntersection> raytrace(PolygonData& objects, TextureMap& textures, glm::vec3 start, glm::vec3 direction, glm::vec3 lightOrigin, Camera& camera, std::set<std::string>& hiddenObjects) {
-		// get initial ray trace
-		RayTriangleIntersection intersection = getClosestValidIntersection(start, direction, objects, hiddenObjects);
+	RayTriangleIntersection getPacketIntersection(RayPacket& packet, int ray, PolygonData& objects) {
+		RayTriangleIntersection closest;
+		const BVHHit& hit = packet.hits[ray];
+		closest.distanceFromCamera = hit.triangleIndex == -1 ? std::numeric_limits<float>::max() : hit.distance;
+		closest.triangleIndex = hit.triangleIndex;
+		if (hit.triangleIndex == -1) return closest;
+		glm::vec3 direction(packet.directionX[ray], packet.directionY[ray], packet.directionZ[ray]);
+		closest.intersectedTriangle = objects.loadedTriangles[hit.triangleIndex];
+		closest.intersectionPoint = packet.origin + hit.distance * direction;
+		closest.barycentric = glm::vec3{ hit.u, hit.v, 1 - (hit.u + hit.v) };
+		return closest;
+	}
+
+	// separating axis test between the pyramid from apex over the triangle and a box, true when they may overlap
+	bool pyramidOverlapsBox(glm::vec3 apex, const std::array<glm::vec3, 3>& base, glm::vec3 boxMin, glm::vec3 boxMax) {
+		glm::vec3 corners[4] = { apex, base[0], base[1], base[2] };
+		glm::vec3 edges[6] = { base[1] - base[0], base[2] - base[1], base[0] - base[2], apex - base[0], apex - base[1], apex - base[2] };
+		glm::vec3 boxAxes[3] = { glm::vec3(1, 0, 0), glm::vec3(0, 1, 0), glm::vec3(0, 0, 1) };
+		// the box's faces, the base, the three side faces and every edge crossed with every box axis
+		glm::vec3 axes[3 + 1 + 3 + 6 * 3] = { boxAxes[0], boxAxes[1], boxAxes[2], glm::cross(edges[0], edges[1]) };
+		int axisCount = 4;
+		for (int edge = 0; edge < 3; edge++) axes[axisCount++] = glm::cross(edges[edge], edges[3 + edge]);
+		for (glm::vec3 edge : edges) {
+			for (glm::vec3 boxAxis : boxAxes) axes[axisCount++] = glm::cross(edge, boxAxis);
+		}
+		glm::vec3 centre = (boxMin + boxMax) * 0.5f;
+		glm::vec3 extent = (boxMax - boxMin) * 0.5f;
+		for (glm::vec3 axis : axes) {
+			float pyramidMin = std::numeric_limits<float>::max();
+			float pyramidMax = -std::numeric_limits<float>::max();
+			for (glm::vec3 corner : corners) {
+				pyramidMin = glm::min(pyramidMin, glm::dot(corner, axis));
+				pyramidMax = glm::max(pyramidMax, glm::dot(corner, axis));
+			}
+			float boxRadius = glm::dot(extent, glm::abs(axis));
+			float boxCentre = glm::dot(centre, axis);
+			if (pyramidMin > boxCentre + boxRadius || pyramidMax < boxCentre - boxRadius) return false;
+		}
+		return true;
+	}
+
+	// separating axis test between the pyramid from apex over base and a triangle, true when they overlap
+	bool pyramidOverlapsTriangle(glm::vec3 apex, const std::array<glm::vec3, 3>& base, const std::array<glm::vec3, 3>& triangle) {
+		glm::vec3 corners[4] = { apex, base[0], base[1], base[2] };
+		glm::vec3 edges[6] = { base[1] - base[0], base[2] - base[1], base[0] - base[2], apex - base[0], apex - base[1], apex - base[2] };
+		glm::vec3 triangleEdges[3] = { triangle[1] - triangle[0], triangle[2] - triangle[1], triangle[0] - triangle[2] };
+		// the pyramid's four faces, the triangle's face and every pyramid edge crossed with every triangle edge
+		glm::vec3 axes[4 + 1 + 6 * 3] = { glm::cross(edges[0], edges[1]), glm::cross(triangleEdges[0], triangleEdges[1]) };
+		int axisCount = 2;
+		for (int edge = 0; edge < 3; edge++) axes[axisCount++] = glm::cross(edges[edge], edges[3 + edge]);
+		for (glm::vec3 edge : edges) {
+			for (glm::vec3 triangleEdge : triangleEdges) axes[axisCount++] = glm::cross(edge, triangleEdge);
+		}
+		for (glm::vec3 axis : axes) {
+			float pyramidMin = std::numeric_limits<float>::max();
+			float pyramidMax = -std::numeric_limits<float>::max();
+			for (glm::vec3 corner : corners) {
+				pyramidMin = glm::min(pyramidMin, glm::dot(corner, axis));
+				pyramidMax = glm::max(pyramidMax, glm::dot(corner, axis));
+			}
+			float triangleMin = std::numeric_limits<float>::max();
+			float triangleMax = -std::numeric_limits<float>::max();
+			for (glm::vec3 corner : triangle) {
+				triangleMin = glm::min(triangleMin, glm::dot(corner, axis));
+				triangleMax = glm::max(triangleMax, glm::dot(corner, axis));
+			}
+			if (pyramidMin > triangleMax || pyramidMax < triangleMin) return false;
+		}
+		return true;
+	}
+
+	// descends the tree of instance down to single triangles, true when any but excludeTriangle overlaps the pyramid
+	bool pyramidReachesInstance(glm::vec3 apex, const std::array<glm::vec3, 3>& base, const ObjectInstance& instance, PolygonData& objects,
+		int excludeTriangle) {
+		const BoundingVolumeHierarchy& bvh = instance.bvh;
+		int stack[MAX_STACK_SIZE];
+		int stackSize = 0;
+		stack[stackSize++] = 0;
+		while (stackSize > 0) {
+			const BVHNode& node = bvh.nodes[stack[--stackSize]];
+			if (!pyramidOverlapsBox(apex, base, node.boundsMin, node.boundsMax)) continue;
+			if (node.triangleCount == 0) {
+				stack[stackSize++] = node.leftFirst;
+				stack[stackSize++] = node.leftFirst + 1;
+				continue;
+			}
+			for (int slot = node.leftFirst; slot < node.leftFirst + node.triangleCount; slot++) {
+				int triangleIndex = bvh.primitiveIndices[slot];
+				if (triangleIndex == excludeTriangle) continue;
+				const auto& bounds = objects.loadedTriangles[triangleIndex].boundingMinMax;
+				if (!pyramidOverlapsBox(apex, base, bounds.first, bounds.second)) continue;
+				std::array<glm::vec3, 3> corners;
+				for (int corner = 0; corner < 3; corner++) corners[corner] = objects.getTriangleVertexPosition(triangleIndex, corner);
+				if (pyramidOverlapsTriangle(apex, base, corners)) return true;
+			}
+		}
+		return false;
+	}
+
+	// vertex positions and normals per component, and where their diffuse and specular terms go
+	struct VertexLightingPass {
+		const float* positionX;
+		const float* positionY;
+		const float* positionZ;
+		const float* normalX;
+		const float* normalY;
+		const float* normalZ;
+		float* diffuse;
+		float* specular;
+		glm::vec3 lightPosition;
+		glm::vec3 cameraPosition;
+	};
+
+	// getLightAttributes for the vertices in [first, end)
+	void lightVerticesScalar(const VertexLightingPass& pass, int first, int end) {
+		glm::vec3 lightPosition = pass.lightPosition;
+		glm::vec3 cameraPosition = pass.cameraPosition;
+		for (int vertex = first; vertex < end; vertex++) {
+			glm::vec3 position(pass.positionX[vertex], pass.positionY[vertex], pass.positionZ[vertex]);
+			glm::vec3 normal(pass.normalX[vertex], pass.normalY[vertex], pass.normalZ[vertex]);
+			glm::vec2 lightingComponents = getLightAttributes(normal, lightPosition, cameraPosition, position);
+			pass.diffuse[vertex] = lightingComponents.x;
+			pass.specular[vertex] = lightingComponents.y;
+		}
+	}
+
+#ifdef USE_SSE_LIGHTING
+	__m128 dotLanes(__m128 ax, __m128 ay, __m128 az, __m128 bx, __m128 by, __m128 bz) {
+		return _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_mul_ps(az, bz));
+	}
+
+	// getLightAttributes for four vertices per iteration, end - first has to be a multiple of 4
+	void lightVerticesSSE(const VertexLightingPass& pass, int first, int end) {
+		__m128 lightX = _mm_set1_ps(pass.lightPosition.x), lightY = _mm_set1_ps(pass.lightPosition.y), lightZ = _mm_set1_ps(pass.lightPosition.z);
+		__m128 cameraX = _mm_set1_ps(pass.cameraPosition.x), cameraY = _mm_set1_ps(pass.cameraPosition.y), cameraZ = _mm_set1_ps(pass.cameraPosition.z);
+		__m128 one = _mm_set1_ps(1.0f);
+		__m128 two = _mm_set1_ps(2.0f);
+		for (int vertex = first; vertex < end; vertex += 4) {
+			__m128 positionX = _mm_loadu_ps(pass.positionX + vertex), positionY = _mm_loadu_ps(pass.positionY + vertex), positionZ = _mm_loadu_ps(pass.positionZ + vertex);
+			__m128 normalX = _mm_loadu_ps(pass.normalX + vertex), normalY = _mm_loadu_ps(pass.normalY + vertex), normalZ = _mm_loadu_ps(pass.normalZ + vertex);
+			__m128 toLightX = _mm_sub_ps(lightX, positionX), toLightY = _mm_sub_ps(lightY, positionY), toLightZ = _mm_sub_ps(lightZ, positionZ);
+			__m128 lightDistanceSquared = dotLanes(toLightX, toLightY, toLightZ, toLightX, toLightY, toLightZ);
+			__m128 lightDistance = _mm_sqrt_ps(lightDistanceSquared);
+			__m128 inverseLightDistance = _mm_div_ps(one, lightDistance);
+			__m128 lightDirectionX = _mm_mul_ps(toLightX, inverseLightDistance);
+			__m128 lightDirectionY = _mm_mul_ps(toLightY, inverseLightDistance);
+			__m128 lightDirectionZ = _mm_mul_ps(toLightZ, inverseLightDistance);
+
+			__m128 proximityComponent = one;
+			if (lighting.useProximity) {
+				proximityComponent = _mm_div_ps(_mm_set1_ps(10), _mm_mul_ps(_mm_set1_ps(4 * glm::pi<float>()), _mm_mul_ps(lightDistance, lightDistance)));
+			}
+			__m128 incidentComponent = one;
+			if (lighting.useIncidence) {
+				incidentComponent = _mm_mul_ps(dotLanes(normalX, normalY, normalZ, lightDirectionX, lightDirectionY, lightDirectionZ), _mm_set1_ps(0.5f));
+			}
+			_mm_storeu_ps(pass.diffuse + vertex, _mm_mul_ps(proximityComponent, incidentComponent));
+
+			__m128 specularComponent = _mm_setzero_ps();
+			if (lighting.useSpecular) {
+				__m128 negative = _mm_set1_ps(-0.0f);
+				__m128 incidentX = _mm_xor_ps(lightDirectionX, negative), incidentY = _mm_xor_ps(lightDirectionY, negative), incidentZ = _mm_xor_ps(lightDirectionZ, negative);
+				__m128 normalDotIncident = dotLanes(normalX, normalY, normalZ, incidentX, incidentY, incidentZ);
+				__m128 reflectionX = _mm_sub_ps(incidentX, _mm_mul_ps(_mm_mul_ps(normalX, normalDotIncident), two));
+				__m128 reflectionY = _mm_sub_ps(incidentY, _mm_mul_ps(_mm_mul_ps(normalY, normalDotIncident), two));
+				__m128 reflectionZ = _mm_sub_ps(incidentZ, _mm_mul_ps(_mm_mul_ps(normalZ, normalDotIncident), two));
+				__m128 toCameraX = _mm_sub_ps(cameraX, positionX), toCameraY = _mm_sub_ps(cameraY, positionY), toCameraZ = _mm_sub_ps(cameraZ, positionZ);
+				__m128 inverseCameraDistance = _mm_div_ps(one, _mm_sqrt_ps(dotLanes(toCameraX, toCameraY, toCameraZ, toCameraX, toCameraY, toCameraZ)));
+				__m128 specularity = dotLanes(reflectionX, reflectionY, reflectionZ,
+					_mm_mul_ps(toCameraX, inverseCameraDistance), _mm_mul_ps(toCameraY, inverseCameraDistance), _mm_mul_ps(toCameraZ, inverseCameraDistance));
+				specularComponent = _mm_max_ps(specularity, _mm_setzero_ps());
+				for (int i = 0; i < 7; i++) specularComponent = _mm_mul_ps(specularComponent, specularComponent);
+			}
+			_mm_storeu_ps(pass.specular + vertex, specularComponent);
+		}
+	}
+#endif
+
+	// rays of one stage, one array per component so that the stage loops stream through them
+	struct RayQueue {
+		std::vector<glm::vec3> origins;
+		std::vector<glm::vec3> directions;
+		std::vector<float> maxDistances;
+		std::vector<int> excludeIDs;
+		std::vector<int> surfaces; // surface each ray was emitted for
+
+		void clear() {
+			origins.clear();
+			directions.clear();
+			maxDistances.clear();
+			excludeIDs.clear();
+			surfaces.clear();
+		}
+
+		void push(glm::vec3 origin, glm::vec3 direction, float maxDistance, int excludeID, int surface) {
+			origins.push_back(origin);
+			directions.push_back(direction);
+			maxDistances.push_back(maxDistance);
+			excludeIDs.push_back(excludeID);
+			surfaces.push_back(surface);
+		}
+
+		int size() const {
+			return origins.size();
+		}
+	};
+
+	// where a primary or reflection ray landed, and what the shadow stages found out about it
+	struct Surface {
+		glm::vec3 start; // origin of the ray that found it, the viewpoint of its specular highlight
+		RayTriangleIntersection intersection;
+		Colour baseColour;
+		glm::vec3 interpolatedNormal; // normal interpolated by the pixel, for Phong shading
+		bool hardShadowed;
+		int softSamples; // 0 when the light was not sampled, which leaves it fully lit. includes earlier frames' when accumulating
+		int softHits;
+		bool reprojected; // carried over from the last frame with its final colour as baseColour, later stages skip it
+		float cachedVisibility; // soft shadowing interpolated from the irradiance cache instead of the samples, negative when not
+	};
+
+	// everything the rays of one tile pass through. kept per thread, so the buffers are only allocated once
+	struct Wave {
+		std::vector<glm::ivec2> pixels;
+		std::vector<glm::vec3> directions; // primary directions, parallel to pixels
+		std::vector<int> packetEnds; // primary rays are generated and intersected in packets of neighbours
+		std::vector<Surface> surfaces; // one per pixel, followed by the reflections
+		std::vector<int> reflectionOf; // primary surface each reflection is seen in
+		std::vector<int> hits; // compacted surfaces of the current bounce that a ray hit
+		std::vector<Colour> colours; // shaded colour of every surface
+		RayQueue shadowRays;
+		RayQueue reflectionRays;
+		bool accumulating; // surfaces carry soft shadow samples over from earlier frames
+		const LightVisibility* visibility; // hard shadows of whole triangles, null when every hit fires its own ray
+		IrradianceCache* irradiance; // soft shadows of hits it covers, null when every hit fires its own rays
+		std::vector<IrradianceRecord> newRecords; // sampled by this tile, handed to irradiance once it is done
+
+		void clear() {
+			pixels.clear();
+			directions.clear();
+			packetEnds.clear();
+			surfaces.clear();
+			reflectionOf.clear();
+			newRecords.clear();
+		}
+	};
+
+	// looks up everything about a fresh hit that does not depend on the light
+	Surface describeSurface(PolygonData& objects, TextureMap& textures, glm::vec3 start, RayTriangleIntersection intersection) {
+		Surface surface = { start, intersection, Colour(), glm::vec3(0), false, 0, 0, false, -1 };
+		if (intersection.triangleIndex == -1) return surface;
+		surface.baseColour = intersection.intersectedTriangle.colour;
+		// conditionally get texture map as pixel color
+		if (intersection.intersectedTriangle.texturePoints[0] != -1) {
+			surface.baseColour = getRaytracedTexture(objects, intersection, textures);
+		}
+		surface.interpolatedNormal = getPhongNormal(objects, intersection);
+		return surface;
+	}
+
+	PrimaryHit recordPrimaryHit(Surface& surface) {
+		const RayTriangleIntersection& intersection = surface.intersection;
 		if (intersection.triangleIndex == -1) {
-			return { Colour(), intersection };
+			return { -1, std::numeric_limits<float>::max(), glm::vec3(0), glm::vec3(0), glm::vec3(0), glm::vec3(0), 0 };
 		}
+		return { int(intersection.triangleIndex), intersection.distanceFromCamera, intersection.intersectionPoint, intersection.barycentric,
+			intersection.intersectedTriangle.normal, surface.interpolatedNormal, surface.baseColour.asNumeric() };
+	}
 
-		// conditionally apply hard shadows
-		if (lighting.useShadow) {
-			// check they're on the same side
+	Surface restorePrimaryHit(PolygonData& objects, glm::vec3 start, const PrimaryHit& hit) {
+		Surface surface = { start, RayTriangleIntersection(), Colour(hit.baseColour), hit.interpolatedNormal, false, 0, 0, false, -1 };
+		RayTriangleIntersection& intersection = surface.intersection;
+		intersection.distanceFromCamera = hit.distance;
+		intersection.triangleIndex = hit.triangleIndex;
+		if (hit.triangleIndex == -1) return surface;
+		intersection.intersectedTriangle = objects.loadedTriangles[hit.triangleIndex];
+		intersection.intersectionPoint = hit.position;
+		intersection.barycentric = hit.barycentric;
+		return surface;
+	}
+
+	void generatePrimaryRays(Wave& wave, glm::ivec2 tileMin, glm::ivec2 tileMax, const RenderTarget& target, Camera& camera, int step, bool skipCoarser) {
+		glm::mat3 inverseViewMatrix = glm::inverse(camera.viewMatrix);
+		int packetSpan = RAY_PACKET_SIZE * step;
+		for (int packetY = tileMin.y; packetY < tileMax.y; packetY += packetSpan) {
+			for (int packetX = tileMin.x; packetX < tileMax.x; packetX += packetSpan) {
+				int endY = glm::min(packetY + packetSpan, tileMax.y);
+				int endX = glm::min(packetX + packetSpan, tileMax.x);
+				int packetStart = wave.pixels.size();
+				for (int y = packetY; y < endY; y += step) {
+					for (int x = packetX; x < endX; x += step) {
+						// already traced by the pass at twice the spacing
+						if (skipCoarser && x % (2 * step) == 0 && y % (2 * step) == 0) continue;
+						glm::vec3 canvasPosition = getCanvasPosition(camera, target, x, y, inverseViewMatrix);
+						wave.pixels.push_back({ x, y });
+						wave.directions.push_back(glm::normalize(camera.cameraPosition - canvasPosition));
+					}
+				}
+				if (int(wave.pixels.size()) > packetStart) wave.packetEnds.push_back(wave.pixels.size());
+			}
+		}
+	}
+
+	// packets share their traversal, so neighbouring rays pull the same nodes through the cache. packets whose
+	// pixels geometry already holds are restored from it instead, and the hits of the others are recorded in it
+	void intersectPrimaryRays(Wave& wave, PolygonData& objects, TextureMap& textures, Camera& camera, GeometryBuffer* geometry) {
+		int packetStart = 0;
+		for (int packetEnd : wave.packetEnds) {
+			bool cached = geometry != nullptr;
+			for (int ray = packetStart; cached && ray < packetEnd; ray++) {
+				glm::ivec2 pixel = wave.pixels[ray];
+				cached = geometry->hits[pixel.y][pixel.x].triangleIndex != UNTRACED;
+			}
+			if (cached) {
+				for (int ray = packetStart; ray < packetEnd; ray++) {
+					glm::ivec2 pixel = wave.pixels[ray];
+					wave.surfaces.push_back(restorePrimaryHit(objects, camera.cameraPosition, geometry->hits[pixel.y][pixel.x]));
+				}
+				packetStart = packetEnd;
+				continue;
+			}
+			RayPacket packet;
+			initialiseRayPacket(packet, camera.cameraPosition, &wave.directions[packetStart], packetEnd - packetStart, std::numeric_limits<float>::max());
+			objects.accelerator.intersectPacket(packet);
+			for (int ray = 0; ray < packet.rayCount; ray++) {
+				wave.surfaces.push_back(describeSurface(objects, textures, camera.cameraPosition, getPacketIntersection(packet, ray, objects)));
+				if (geometry == nullptr) continue;
+				glm::ivec2 pixel = wave.pixels[packetStart + ray];
+				geometry->hits[pixel.y][pixel.x] = recordPrimaryHit(wave.surfaces.back());
+			}
+			packetStart = packetEnd;
+		}
+	}
+
+	// keeps the surfaces in [first, end) that were actually hit and still need shading
+	void compactHits(Wave& wave, int first, int end) {
+		wave.hits.clear();
+		for (int surface = first; surface < end; surface++) {
+			if (wave.surfaces[surface].intersection.triangleIndex != -1 && !wave.surfaces[surface].reprojected) wave.hits.push_back(surface);
+		}
+	}
+
+	// one ray towards the centre of the light from every hit that faces the camera
+	void traceHardShadows(Wave& wave, PolygonData& objects, glm::vec3 lightOrigin, Camera& camera) {
+		RayQueue& queue = wave.shadowRays;
+		queue.clear();
+		for (int surfaceIndex : wave.hits) {
+			RayTriangleIntersection& intersection = wave.surfaces[surfaceIndex].intersection;
 			glm::vec3 normal = intersection.intersectedTriangle.normal;
 			glm::vec3 offsetPoint = intersection.intersectionPoint + 0.01f * normal;
-
 			glm::vec3 cameraDirection = glm::normalize(camera.cameraPosition - offsetPoint); // point to camera
+			if (glm::dot(normal, cameraDirection) <= 0) continue;
 			glm::vec3 lightDirection = glm::normalize(lightOrigin - offsetPoint);
-			float cameraNormalAngle = glm::dot(normal, cameraDirection);
-			float lightNormalAngle = glm::dot(normal, lightDirection);
-			if (cameraNormalAngle > 0 || cameraNormalAngle > 0 && lightNormalAngle < 0) {
-				float lightDistance = glm::length(lightOrigin - camera.cameraPosition);
-				RayTriangleIntersection shadowIntersection =
-					getClosestValidIntersection(offsetPoint, lightDirection, objects, hiddenObjects, intersection.triangleIndex, lightDistance);
-
-				if (shadowIntersection.triangleIndex != -1) {
-					RayTriangleIntersection hardShadow(glm::vec3{ 0,0,0 }, 0, ModelTriangle(), -1);
-					return { lighting.useAmbience ? globalAmbientColor : Colour(), hardShadow };
+			// only what lies between the surface and the light casts a shadow, as for the vertex samples below
+			float lightDistance = glm::length(lightOrigin - offsetPoint);
+			if (wave.visibility != nullptr) {
+				TriangleShadowing shadowing = wave.visibility->triangles[intersection.triangleIndex];
+				if (shadowing == SHADOWED_TRIANGLE) wave.surfaces[surfaceIndex].hardShadowed = true;
+				if (shadowing != MIXED_TRIANGLE) continue;
+			}
+			queue.push(offsetPoint, lightDirection, lightDistance, intersection.triangleIndex, surfaceIndex);
+		}
+		for (int ray = 0; ray < queue.size(); ray++) {
+			if (objects.accelerator.occluded(queue.origins[ray], queue.directions[ray], queue.excludeIDs[ray], queue.maxDistances[ray])) {
+				wave.surfaces[queue.surfaces[ray]].hardShadowed = true;
+			}
+		}
+	}
+
+	// soft shadow visibility at point, with its gradient along the surface taken from rays sharing the same light samples
+	IrradianceRecord sampleIrradiance(PolygonData& objects, glm::vec3 point, glm::vec3 normal, int triangleIndex, glm::vec3 lightOrigin) {
+		glm::vec3 tangent = glm::normalize(glm::cross(normal, glm::abs(normal.x) < 0.9f ? glm::vec3(1, 0, 0) : glm::vec3(0, 1, 0)));
+		glm::vec3 bitangent = glm::cross(normal, tangent);
+		glm::vec3 points[3] = { point, point + GRADIENT_STEP * tangent, point + GRADIENT_STEP * bitangent };
+		int reached[3] = { 0, 0, 0 };
+		for (int i = 0; i < IRRADIANCE_SAMPLES; i++) {
+			glm::vec3 sampledLight = Lighting::sampleLightPosition(lightOrigin, LIGHT_RADIUS);
+			for (int p = 0; p < 3; p++) {
+				glm::vec3 direction = glm::normalize(sampledLight - points[p]);
+				float lightDistance = glm::length(sampledLight - points[p]);
+				if (!objects.accelerator.occluded(points[p], direction, triangleIndex, lightDistance)) reached[p]++;
+			}
+		}
+		glm::vec3 gradient = (float(reached[1] - reached[0]) * tangent + float(reached[2] - reached[0]) * bitangent) / (IRRADIANCE_SAMPLES * GRADIENT_STEP);
+		float change = glm::length(gradient);
+		float radius = change > 0 ? glm::clamp(MAX_VISIBILITY_CHANGE / change, MIN_RECORD_RADIUS, MAX_RECORD_RADIUS) : MAX_RECORD_RADIUS;
+		return { point, normal, float(reached[0]) / IRRADIANCE_SAMPLES, gradient, radius };
+	}
+
+	// a spread of rays towards random points on the light from every hit facing the camera and out of hard shadow.
+	// hits the irradiance cache covers take their visibility from it, the others sample a record for it
+	void traceSoftShadows(Wave& wave, PolygonData& objects, glm::vec3 lightOrigin, Camera& camera) {
+		RayQueue& queue = wave.shadowRays;
+		queue.clear();
+		for (int surfaceIndex : wave.hits) {
+			Surface& surface = wave.surfaces[surfaceIndex];
+			if (surface.hardShadowed) continue;
+			glm::vec3 normal = surface.intersection.intersectedTriangle.normal;
+			glm::vec3 offsetPoint = surface.intersection.intersectionPoint + 0.01f * normal;
+			glm::vec3 cameraDirection = glm::normalize(camera.cameraPosition - offsetPoint); // point to camera
+			if (glm::dot(normal, cameraDirection) < 0) continue;
+			if (wave.irradiance != nullptr) {
+				if (!wave.irradiance->lookup(offsetPoint, normal, wave.newRecords, surface.cachedVisibility)) {
+					wave.newRecords.push_back(sampleIrradiance(objects, offsetPoint, normal, surface.intersection.triangleIndex, lightOrigin));
+					surface.cachedVisibility = wave.newRecords.back().visibility;
 				}
+				continue;
+			}
+			int rayCount = wave.accumulating ? glm::min(SAMPLES_PER_FRAME, ACCUMULATED_SAMPLES - surface.softSamples) : SOFT_SHADOW_SAMPLES;
+			surface.softSamples += rayCount;
+			for (int i = 0; i < rayCount; i++) {
+				glm::vec3 sampledLight = Lighting::sampleLightPosition(lightOrigin, LIGHT_RADIUS);
+				glm::vec3 direction = glm::normalize(sampledLight - offsetPoint);
+				float lightDistance = glm::length(sampledLight - offsetPoint);
+				queue.push(offsetPoint, direction, lightDistance, surface.intersection.triangleIndex, surfaceIndex);
 			}
 		}
-		// conditionally get texture map as pixel color, which needs on-the-fly getLightAttribute.
-		Colour baseColor = intersection.intersectedTriangle.colour;
-		if (intersection.intersectedTriangle.texturePoints[0] != -1) {
-			baseColor = getRaytracedTexture(objects, intersection, textures);
+		for (int ray = 0; ray < queue.size(); ray++) {
+			if (!objects.accelerator.occluded(queue.origins[ray], queue.directions[ray], queue.excludeIDs[ray], queue.maxDistances[ray])) {
+				wave.surfaces[queue.surfaces[ray]].softHits++;
+			}
 		}
+	}
+
+	void traceShadows(Wave& wave, PolygonData& objects, glm::vec3 lightOrigin, Camera& camera) {
+		if (lighting.useShadow) traceHardShadows(wave, objects, lightOrigin, camera);
+		if (lighting.useSoftShadow) traceSoftShadows(wave, objects, lightOrigin, camera);
+	}
+
+	// one bounce off every reflective primary hit that is not in hard shadow, appended to the surfaces
+	void traceReflections(Wave& wave, PolygonData& objects, TextureMap& textures) {
+		RayQueue& queue = wave.reflectionRays;
+		queue.clear();
+		for (int surfaceIndex : wave.hits) {
+			Surface& surface = wave.surfaces[surfaceIndex];
+			float reflectivity = surface.intersection.intersectedTriangle.reflectivity;
+			if (surface.hardShadowed || !std::isgreater(reflectivity, 0)) continue;
+			glm::vec3 normal = lighting.usePhong ? surface.interpolatedNormal : surface.intersection.intersectedTriangle.normal;
+			glm::vec3 reflectionRay = glm::reflect(wave.directions[surfaceIndex], normal);
+			glm::vec3 offsetPoint = surface.intersection.intersectionPoint + 0.01f * normal;
+			queue.push(offsetPoint, reflectionRay, std::numeric_limits<float>::max(), -1, surfaceIndex);
+		}
+		for (int ray = 0; ray < queue.size(); ray++) {
+			RayTriangleIntersection intersection = getClosestValidIntersection(queue.origins[ray], queue.directions[ray], objects);
+			wave.surfaces.push_back(describeSurface(objects, textures, queue.origins[ray], intersection));
+			wave.reflectionOf.push_back(queue.surfaces[ray]);
+		}
+	}
+
+	Colour shadeSurface(PolygonData& objects, Surface& surface, glm::vec3 lightOrigin) {
+		RayTriangleIntersection& intersection = surface.intersection;
+		if (intersection.triangleIndex == -1) return Colour();
+		if (surface.reprojected) return surface.baseColour;
+		Colour ambience = lighting.useAmbience ? globalAmbientColor : Colour();
+		if (surface.hardShadowed) return ambience;
+
+		Colour baseColor = surface.baseColour;
 		// diverge between phong and gouraud shading and calculate diffuse & specular components
 		Colour diffuse = baseColor;
 		Colour specular = globalLightColor;
 		if (lighting.usePhong) {
-			glm::vec2 lightingComponents = calculatePhongComponents(objects, intersection, lightOrigin, start);
+			glm::vec2 lightingComponents = getLightAttributes(surface.interpolatedNormal, lightOrigin, surface.start, intersection.intersectionPoint);
 			diffuse *= lightingComponents.x;
 			specular *= lightingComponents.y;
 		}
@@ -224,70 +613,220 @@ namespace {
 				globalLightColor * lightingComponents[2].y;
 		}
 
-		float brightness = 1;
-		if (lighting.useSoftShadow) {
-			brightness = getSoftShadow(objects, intersection, lightOrigin, camera.cameraPosition, hiddenObjects);
-		}
-
-		Colour ambience = lighting.useAmbience ? globalAmbientColor : Colour();
+		float brightness = surface.softSamples > 0 ? float(surface.softHits) / surface.softSamples : 1;
+		if (surface.cachedVisibility >= 0) brightness = surface.cachedVisibility;
 		// apply shading to color
-		Colour finalColor = (ambience + diffuse + specular) * brightness;
-		return { finalColor, intersection };
+		return (ambience + diffuse + specular) * brightness;
 	}
 }
 
-void Raytrace::renderSegment(glm::vec2 boundY, std::vector<std::vector<uint32_t>>& colorBuffer, PolygonData& objects, Camera& camera, TextureMap& textures, glm::vec3 lightOrigin, std::set<std::string>& hiddenObjects) {
-	glm::mat3 inverseViewMatrix = glm::inverse(camera.viewMatrix);
-	for (int y = boundY[0]; y < boundY[1]; y++) {
-		for (int x = 0; x < WIDTH; x++) {
-			if (x == WIDTH / 4 * 3 && y == HEIGHT / 2) {
-				std::cout << "here" << std::endl;
-			}
-			// get point on the ray trace
-			glm::vec3 canvasPosition = getCanvasPosition(camera, x, y, inverseViewMatrix);
-			glm::vec3 direction = glm::normalize(camera.cameraPosition - canvasPosition);
+void Raytrace::renderTile(glm::ivec2 tileMin, glm::ivec2 tileMax, const RenderTarget& target, std::vector<std::vector<uint32_t>>& colorBuffer, PolygonData& objects, Camera& camera, TextureMap& textures, glm::vec3 lightOrigin, const TraceSettings& settings) {
+	ShadowAccumulation* shadows = settings.shadows;
+	const ReprojectionCache* reprojection = settings.reprojection;
+	// the tile's rays go through one stage at a time instead of one pixel at a time
+	thread_local Wave wave;
+	wave.clear();
+	wave.irradiance = lighting.useSoftShadow && lighting.useIrradianceCache ? settings.irradiance : nullptr;
+	wave.accumulating = shadows != nullptr && lighting.useSoftShadow && wave.irradiance == nullptr;
+	wave.visibility = lighting.useVertexShadows && !lighting.usePhong ? settings.visibility : nullptr;
+	generatePrimaryRays(wave, tileMin, tileMax, target, camera, settings.step, settings.skipCoarser);
+	intersectPrimaryRays(wave, objects, textures, camera, settings.geometry);
+	int primaryCount = wave.pixels.size();
+	for (int ray = 0; reprojection != nullptr && ray < primaryCount; ray++) {
+		Surface& surface = wave.surfaces[ray];
+		uint32_t colour;
+		if (surface.intersection.triangleIndex == -1) continue;
+		if (!reprojection->lookup(wave.pixels[ray], surface.intersection.triangleIndex, surface.intersection.distanceFromCamera, surface.interpolatedNormal, colour)) continue;
+		surface.reprojected = true;
+		surface.baseColour = Colour(colour);
+	}
+	if (wave.accumulating) {
+		for (int ray = 0; ray < primaryCount; ray++) {
+			const ShadowSamples& gathered = shadows->samples[wave.pixels[ray].y][wave.pixels[ray].x];
+			wave.surfaces[ray].softSamples = gathered.primarySamples;
+			wave.surfaces[ray].softHits = gathered.primaryHits;
+		}
+	}
 
+	compactHits(wave, 0, primaryCount);
+	traceShadows(wave, objects, lightOrigin, camera);
+	if (lighting.useReflections) {
+		traceReflections(wave, objects, textures);
+		for (int reflection = 0; wave.accumulating && reflection < int(wave.reflectionOf.size()); reflection++) {
+			glm::ivec2 pixel = wave.pixels[wave.reflectionOf[reflection]];
+			const ShadowSamples& gathered = shadows->samples[pixel.y][pixel.x];
+			wave.surfaces[primaryCount + reflection].softSamples = gathered.reflectionSamples;
+			wave.surfaces[primaryCount + reflection].softHits = gathered.reflectionHits;
+		}
+		compactHits(wave, primaryCount, wave.surfaces.size());
+		traceShadows(wave, objects, lightOrigin, camera);
+	}
+	if (wave.accumulating) {
+		for (int ray = 0; ray < primaryCount; ray++) {
+			ShadowSamples& gathered = shadows->samples[wave.pixels[ray].y][wave.pixels[ray].x];
+			gathered.primarySamples = wave.surfaces[ray].softSamples;
+			gathered.primaryHits = wave.surfaces[ray].softHits;
+		}
+		for (int reflection = 0; reflection < int(wave.reflectionOf.size()); reflection++) {
+			glm::ivec2 pixel = wave.pixels[wave.reflectionOf[reflection]];
+			ShadowSamples& gathered = shadows->samples[pixel.y][pixel.x];
+			gathered.reflectionSamples = wave.surfaces[primaryCount + reflection].softSamples;
+			gathered.reflectionHits = wave.surfaces[primaryCount + reflection].softHits;
+		}
+	}
 
-			auto colorTrianglePair = raytrace(objects, textures, camera.cameraPosition, direction, lightOrigin, camera, hiddenObjects);
+	wave.colours.resize(wave.surfaces.size());
+	for (int surface = 0; surface < int(wave.surfaces.size()); surface++) {
+		wave.colours[surface] = shadeSurface(objects, wave.surfaces[surface], lightOrigin);
+	}
+	// conditionally apply reflectiveness
+	for (int reflection = 0; reflection < int(wave.reflectionOf.size()); reflection++) {
+		int primary = wave.reflectionOf[reflection];
+		float reflectivity = wave.surfaces[primary].intersection.intersectedTriangle.reflectivity;
+		wave.colours[primary] = wave.colours[primary] * (1 - reflectivity) + wave.colours[primaryCount + reflection] * reflectivity;
+	}
+	for (int ray = 0; ray < primaryCount; ray++) {
+		glm::ivec2 pixel = wave.pixels[ray];
+		colorBuffer[pixel.y][pixel.x] = wave.colours[ray].asNumeric();
+	}
+	if (wave.irradiance != nullptr) wave.irradiance->add(wave.newRecords);
+}
 
-			Colour color = colorTrianglePair.first;
-			RayTriangleIntersection intersection = colorTrianglePair.second;
+void GeometryBuffer::validate(const Camera& camera, const RenderTarget& target, unsigned version) {
+	bool matches = camera.cameraPosition == cameraPosition && camera.viewMatrix == viewMatrix && target.width == width &&
+		target.height == height && target.scale == scale && target.focalLength == focalLength && version == sceneVersion;
+	if (matches) return;
+	cameraPosition = camera.cameraPosition;
+	viewMatrix = camera.viewMatrix;
+	width = target.width;
+	height = target.height;
+	scale = target.scale;
+	focalLength = target.focalLength;
+	sceneVersion = version;
+	PrimaryHit untraced = { UNTRACED, std::numeric_limits<float>::max(), glm::vec3(0), glm::vec3(0), glm::vec3(0), glm::vec3(0), 0 };
+	target.fitBuffer(hits, untraced);
+	for (auto& row : hits) std::fill(row.begin(), row.end(), untraced);
+	generation++;
+}
 
-			if (intersection.triangleIndex == -1) {
-				colorBuffer[y][x] = color.asNumeric();
-				continue;
-			}
+unsigned GeometryBuffer::getGeneration() const {
+	return generation;
+}
 
-			float reflectivity = intersection.intersectedTriangle.reflectivity;
-			// conditionally apply reflectiveness 
-			if (lighting.useReflections && std::isgreater(reflectivity, 0)) {
-				// isolate normal interpolation function
-				
-				glm::vec3 normal = lighting.usePhong ? getPhongNormal(objects, intersection) : intersection.intersectedTriangle.normal;
-				// calculate reflection ray
-				glm::vec3 reflectionRay = glm::reflect(direction, normal);
-				// raytrace from intersection point in the direction of the reflection
-				glm::vec3 offsetPoint = intersection.intersectionPoint + 0.01f * normal;
-				auto reflectionPair = raytrace(objects, textures, offsetPoint, reflectionRay, lightOrigin, camera, hiddenObjects);
-				color = color * (1 - reflectivity) + reflectionPair.first * reflectivity;
+void ShadowAccumulation::validate(const GeometryBuffer& geometry, const RenderTarget& target, glm::vec3 light) {
+	// the normals decide which surfaces the reflections land on, and so what the reflection samples belong to
+	if (geometry.getGeneration() == geometryGeneration && light == lightOrigin && lighting.usePhong == phongNormals) return;
+	geometryGeneration = geometry.getGeneration();
+	lightOrigin = light;
+	phongNormals = lighting.usePhong;
+	target.fitBuffer(samples, ShadowSamples{ 0, 0, 0, 0 });
+	for (auto& row : samples) std::fill(row.begin(), row.end(), ShadowSamples{ 0, 0, 0, 0 });
+}
+
+void LightVisibility::update(PolygonData& objects, glm::vec3 light) {
+	if (computed && light == lightOrigin && objects.accelerator.version == sceneVersion) return;
+	computed = true;
+	lightOrigin = light;
+	sceneVersion = objects.accelerator.version;
+	const int chunkSize = 256;
+	auto isLit = [&](glm::vec3 point, int excludeID) {
+		return !objects.accelerator.occluded(point, glm::normalize(light - point), excludeID, glm::length(light - point));
+	};
+
+	int vertexCount = objects.loadedVertices.size();
+	vertexLit.resize(vertexCount);
+	threadPool.parallelFor((vertexCount + chunkSize - 1) / chunkSize, [&](int chunk) {
+		int end = glm::min((chunk + 1) * chunkSize, vertexCount);
+		for (int vertexIndex = chunk * chunkSize; vertexIndex < end; vertexIndex++) {
+			const GouraudVertex& vertex = objects.loadedVertices[vertexIndex];
+			vertexLit[vertexIndex] = isLit(vertex.position + 0.01f * vertex.normal, -1);
+		}
+	});
+
+	int triangleCount = objects.loadedTriangles.size();
+	triangles.resize(triangleCount);
+	threadPool.parallelFor((triangleCount + chunkSize - 1) / chunkSize, [&](int chunk) {
+		int end = glm::min((chunk + 1) * chunkSize, triangleCount);
+		for (int triangleIndex = chunk * chunkSize; triangleIndex < end; triangleIndex++) {
+			const ModelTriangle& triangle = objects.loadedTriangles[triangleIndex];
+			std::array<glm::vec3, 3> corners;
+			int litSamples = 0;
+			for (int corner = 0; corner < 3; corner++) {
+				corners[corner] = objects.getTriangleVertexPosition(triangleIndex, corner);
+				// the shared sample sits off the smoothed normal, which stands for no face at a hard edge
+				const GouraudVertex& vertex = objects.loadedVertices[triangle.vertices[corner]];
+				if (glm::dot(vertex.normal, triangle.normal) > SMOOTH_VERTEX_COSINE) litSamples += vertexLit[triangle.vertices[corner]];
+				else litSamples += isLit(corners[corner] + 0.01f * triangle.normal, triangleIndex);
 			}
-			colorBuffer[y][x] = color.asNumeric();
+			for (int edge = 0; edge < 3; edge++) {
+				glm::vec3 midpoint = (corners[edge] + corners[(edge + 1) % 3]) * 0.5f;
+				litSamples += isLit(midpoint + 0.01f * triangle.normal, triangleIndex);
+			}
+			// any other triangle reaching between the triangle and the light can shadow its inside, where no sample
+			// lands. that includes the triangle's own object, which need not be convex
+			std::array<glm::vec3, 3> liftedCorners;
+			for (int corner = 0; corner < 3; corner++) liftedCorners[corner] = corners[corner] + PYRAMID_BASE_LIFT * (light - corners[corner]);
+			bool occluderBetween = false;
+			for (const ObjectInstance& instance : objects.accelerator.instances) {
+				if (!instance.visible || instance.bvh.nodes.empty()) continue;
+				if (pyramidReachesInstance(light, liftedCorners, instance, objects, triangleIndex)) {
+					occluderBetween = true;
+					break;
+				}
+			}
+			if (occluderBetween || (litSamples != 0 && litSamples != 6)) triangles[triangleIndex] = MIXED_TRIANGLE;
+			else triangles[triangleIndex] = litSamples == 6 ? LIT_TRIANGLE : SHADOWED_TRIANGLE;
 		}
-	}
+	});
 }
 
-void Raytrace::preprocessGouraud(PolygonData& objects, glm::vec3& lightPosition, glm::vec3& cameraPosition) {
-	for (auto& vertex : objects.loadedVertices) {
-		glm::vec3 lightDirection = glm::normalize(lightPosition - glm::vec3(vertex));
-		float lightDistance = glm::distance(lightPosition, glm::vec3(vertex));
-
-		if (lighting.useAmbience) vertex.ambient = globalAmbientColor;
-
-		auto attributes = getLightAttributes(vertex.normal, lightPosition,
-			cameraPosition, vertex.position);
-
-		vertex.diffuse = attributes.x;
-		vertex.specular = attributes.y;
+bool VertexLighting::update(PolygonData& objects, glm::vec3 light, glm::vec3 camera) {
+	int vertexCount = objects.loadedVertices.size();
+	bool geometryChanged = !computed || objects.accelerator.version != sceneVersion || int(positionX.size()) != vertexCount;
+	bool viewChanged = lighting.useSpecular && camera != cameraPosition;
+	if (!geometryChanged && !viewChanged && light == lightPosition && lighting == litWith) return false;
+	computed = true;
+	lightPosition = light;
+	cameraPosition = camera;
+	litWith = lighting;
+	sceneVersion = objects.accelerator.version;
+
+	// a multiple of 4, so that only the last chunk has lanes left over
+	const int chunkSize = 1024;
+	int chunkCount = (vertexCount + chunkSize - 1) / chunkSize;
+	if (geometryChanged) {
+		for (auto component : { &positionX, &positionY, &positionZ, &normalX, &normalY, &normalZ, &diffuse, &specular }) {
+			component->resize(vertexCount);
+		}
+		threadPool.parallelFor(chunkCount, [&](int chunk) {
+			int end = glm::min((chunk + 1) * chunkSize, vertexCount);
+			for (int vertexIndex = chunk * chunkSize; vertexIndex < end; vertexIndex++) {
+				const GouraudVertex& vertex = objects.loadedVertices[vertexIndex];
+				positionX[vertexIndex] = vertex.position.x;
+				positionY[vertexIndex] = vertex.position.y;
+				positionZ[vertexIndex] = vertex.position.z;
+				normalX[vertexIndex] = vertex.normal.x;
+				normalY[vertexIndex] = vertex.normal.y;
+				normalZ[vertexIndex] = vertex.normal.z;
+			}
+		});
 	}
-}
 
+	VertexLightingPass pass = { positionX.data(), positionY.data(), positionZ.data(), normalX.data(), normalY.data(), normalZ.data(),
+		diffuse.data(), specular.data(), light, camera };
+	threadPool.parallelFor(chunkCount, [&](int chunk) {
+		int first = chunk * chunkSize;
+		int end = glm::min(first + chunkSize, vertexCount);
+		int simdEnd = first;
+#ifdef USE_SSE_LIGHTING
+		simdEnd = first + (end - first) / 4 * 4;
+		lightVerticesSSE(pass, first, simdEnd);
+#endif
+		lightVerticesScalar(pass, simdEnd, end);
+		for (int vertexIndex = first; vertexIndex < end; vertexIndex++) {
+			objects.loadedVertices[vertexIndex].diffuse = diffuse[vertexIndex];
+			objects.loadedVertices[vertexIndex].specular = specular[vertexIndex];
+		}
+	});
+	return true;
+}
@@ -7,12 +7,133 @@
 #include <PolygonData.h>
 #include <TextureMap.h>
 #include "Lighting.h"
+#include "RenderTarget.h"
 #include <thread>
 #include <sstream>
 
-namespace Raytrace {
+const int UNTRACED = -2;
+
+// the part of a pixel's primary hit that does not depend on the light
+struct PrimaryHit {
+	int triangleIndex; // -1 where the ray escaped, UNTRACED until the pixel has been traced
+	float distance; // along the primary ray, float max where it escaped
+	glm::vec3 position;
+	glm::vec3 barycentric;
+	glm::vec3 faceNormal; // zero where the ray escaped
+	glm::vec3 interpolatedNormal;
+	uint32_t baseColour; // triangle colour or the texel for textured triangles, packed like the colour buffer
+};
+
+// primary hit of every pixel. they stay valid until the camera, the target or the visible geometry changes, so
+// frames that only moved the light or toggled lighting are shaded from them without tracing primary rays
+class GeometryBuffer {
+private:
+	glm::vec3 cameraPosition;
+	glm::mat3 viewMatrix;
+	int width = 0;
+	int height = 0;
+	float scale = 0;
+	float focalLength = 0;
+	unsigned sceneVersion = 0;
+	unsigned generation = 0;
+
+public:
+	std::vector<std::vector<PrimaryHit>> hits;
+
+	// marks every pixel untraced unless the hits were traced for this camera, target and scene version
+	void validate(const Camera& camera, const RenderTarget& target, unsigned sceneVersion);
+
+	// bumped every time validate drops the hits
+	unsigned getGeneration() const;
+};
+
+// soft shadow rays cast so far at a pixel and how many of them reached the light
+struct ShadowSamples {
+	int primarySamples;
+	int primaryHits;
+	int reflectionSamples; // for the surface seen in the pixel's reflection
+	int reflectionHits;
+};
+
+// soft shadow rays gathered for every pixel over successive frames, so that a frame only casts a few more per
+// pixel and a resting view still converges. the samples belong to one generation of a geometry buffer's hits,
+// one light position and one choice of normals to reflect off
+class ShadowAccumulation {
+private:
+	unsigned geometryGeneration = 0;
+	glm::vec3 lightOrigin;
+	bool phongNormals = false;
+
+public:
+	std::vector<std::vector<ShadowSamples>> samples;
+
+	// forgets every sample unless they were gathered for the current hits of geometry, this light and the current
+	// usePhong flag
+	void validate(const GeometryBuffer& geometry, const RenderTarget& target, glm::vec3 lightOrigin);
+};
 
-	void preprocessGouraud(PolygonData& objects, glm::vec3& lightPosition, glm::vec3& cameraPosition);
+enum TriangleShadowing : uint8_t { LIT_TRIANGLE, SHADOWED_TRIANGLE, MIXED_TRIANGLE };
+
+// hard shadowing by the light's centre, sampled at every vertex and edge midpoint. a triangle whose samples agree
+// and whose pyramid towards the light no other triangle reaches into, of its own object or any other, is lit or
+// shadowed as a whole, so only pixels of mixed triangles need shadow rays of their own
+class LightVisibility {
+private:
+	bool computed = false;
+	glm::vec3 lightOrigin;
+	unsigned sceneVersion = 0;
+
+public:
+	std::vector<uint8_t> vertexLit; // parallel to loadedVertices
+	std::vector<TriangleShadowing> triangles; // parallel to loadedTriangles
+
+	// samples the light again when it or the visible geometry moved since the last update
+	void update(PolygonData& objects, glm::vec3 lightOrigin);
+};
+
+// Gouraud lighting of every vertex. it is only redone when the light, the lighting flags or the geometry changed
+// since the last update, or the camera did while specular highlights are on. positions and normals are kept per
+// component, so that the pass lights one vertex per SIMD lane
+class VertexLighting {
+private:
+	bool computed = false;
+	glm::vec3 lightPosition;
+	glm::vec3 cameraPosition;
+	Lighting litWith{ false, false, false, false, false, false }; // set by the first update, before anything reads it
+	unsigned sceneVersion = 0;
+	std::vector<float> positionX, positionY, positionZ;
+	std::vector<float> normalX, normalY, normalZ;
+	std::vector<float> diffuse, specular;
+
+public:
+	// relights the vertices of objects unless none of the inputs changed, returns whether it did
+	bool update(PolygonData& objects, glm::vec3 lightPosition, glm::vec3 cameraPosition);
+};
+
+class ReprojectionCache;
+class IrradianceCache;
+
+// which pixels of a frame are traced and the caches they are traced with, set up once per mode. only every step-th
+// pixel in each direction is traced, and with skipCoarser those a pass at twice the step has already traced are
+// left alone. a mode goes without the caches it leaves null
+struct TraceSettings {
+	int step = 1;
+	bool skipCoarser = false;
+	GeometryBuffer* geometry = nullptr;
+	ShadowAccumulation* shadows = nullptr;
+	ReprojectionCache* reprojection = nullptr;
+	LightVisibility* visibility = nullptr;
+	IrradianceCache* irradiance = nullptr;
+};
+
+namespace Raytrace {
 
-	void renderSegment(glm::vec2 boundY, std::vector<std::vector<uint32_t>>& colorBuffer, PolygonData& objects, Camera& camera, TextureMap& textures, glm::vec3 lightOrigin, std::set<std::string>& hiddenObjects);
+	// traces the pixels in [tileMin, tileMax) of target that settings picks into colorBuffer. with geometry, pixels it
+	// already holds a primary hit for are only shaded and the others have theirs recorded, it has to be validated for
+	// camera first. soft shadows add to shadows when given, which needs geometry and has to be validated for it and
+	// lightOrigin first. pixels reprojection has a matching colour for keep it unshaded. with vertex shadows on,
+	// Gouraud shading takes hard shadows from visibility, which has to be updated for lightOrigin. with the irradiance
+	// cache on, soft shadows come from irradiance, validated for lightOrigin, and the records this tile samples are
+	// queued on it for the next commit
+	void renderTile(glm::ivec2 tileMin, glm::ivec2 tileMax, const RenderTarget& target, std::vector<std::vector<uint32_t>>& colorBuffer, PolygonData& objects, Camera& camera, TextureMap& textures, glm::vec3 lightOrigin, const TraceSettings& settings = TraceSettings());
 }
\ No newline at end of file
@@ -6,49 +6,90 @@
 #include "Rasterize.h"
 #include "Wireframe.h"
 #include "Raytrace.h"
+#include "SceneCache.h"
+#include "ThreadPool.h"
+#include "TileScheduler.h"
+#include "RenderTarget.h"
+#include "ProgressiveRefinement.h"
+#include "FramePipeline.h"
+#include "FrameBudget.h"
+#include "Upsample.h"
+#include "ViewState.h"
+#include "TaskGraph.h"
+#include "Reprojection.h"
+#include "IrradianceCache.h"
+#include <chrono>
 
-void drawInterpolationRenders(DrawingWindow& window, Camera &camera, PolygonData& objects, RenderType type, TextureMap& textures, std::set<std::string>& hiddenObjects) {
+void drawInterpolationRenders(DrawingWindow& window, Camera &camera, PolygonData& objects, RenderType type, TextureMap& textures, const RenderTarget& target, std::vector<std::vector<float>>& zDepth) {
 	window.clearPixels();
 	glm::mat3 viewMatrix = camera.viewMatrix;
-	std::vector<std::vector<float>> zDepth(HEIGHT, std::vector<float>(WIDTH, std::numeric_limits<float>::max()));
-	for (int triangleIndex = 0; triangleIndex < objects.loadedTriangles.size(); triangleIndex++) {
-		if (hiddenObjects.find(objects.loadedTriangles[triangleIndex].objectName) != hiddenObjects.end()) continue;
-		CanvasPoint first = Wireframe::canvasIntersection(camera, objects.getTriangleVertexPosition(triangleIndex, 0), 2.0, viewMatrix);
-		CanvasPoint second = Wireframe::canvasIntersection(camera, objects.getTriangleVertexPosition(triangleIndex, 1), 2.0, viewMatrix);
-		CanvasPoint third = Wireframe::canvasIntersection(camera, objects.getTriangleVertexPosition(triangleIndex, 2), 2.0, viewMatrix);
+	target.fitBuffer(zDepth, std::numeric_limits<float>::max());
+	for (auto& row : zDepth) std::fill(row.begin(), row.end(), std::numeric_limits<float>::max());
+	for (const ObjectInstance& instance : objects.accelerator.instances) {
+		if (!instance.visible) continue;
+		for (int triangleIndex : instance.bvh.primitiveIndices) {
+			CanvasPoint first = Wireframe::canvasIntersection(camera, objects.getTriangleVertexPosition(triangleIndex, 0), target, viewMatrix);
+			CanvasPoint second = Wireframe::canvasIntersection(camera, objects.getTriangleVertexPosition(triangleIndex, 1), target, viewMatrix);
+			CanvasPoint third = Wireframe::canvasIntersection(camera, objects.getTriangleVertexPosition(triangleIndex, 2), target, viewMatrix);
 
-		CanvasTriangle flattened(first, second, third);
-		if (type == POINTCLOUD) Wireframe::drawCloudPoints(window, camera, { first, second, third });
-		else if (type == WIREFRAME) Wireframe::drawStrokedTriangle(window, flattened, Colour(255, 255, 255));
-		else if (type == RASTER) {
-			if (objects.loadedTriangles[triangleIndex].texturePoints[0] == -1) {
-				Rasterize::drawRasterizedTriangle(window, flattened, objects.loadedTriangles[triangleIndex].colour, zDepth);
-			}
-			else {
-				ModelTriangle texturedTriangle = objects.loadedTriangles[triangleIndex];
-				first.texturePoint = objects.loadedTextures[texturedTriangle.texturePoints[0]];
-				second.texturePoint = objects.loadedTextures[texturedTriangle.texturePoints[1]];
-				third.texturePoint = objects.loadedTextures[texturedTriangle.texturePoints[2]];
-				CanvasTriangle triangle = { first, second, third };
-				Rasterize::drawRasterizedTriangle(window, triangle, textures, zDepth);
+			CanvasTriangle flattened(first, second, third);
+			if (type == POINTCLOUD) Wireframe::drawCloudPoints(window, camera, { first, second, third });
+			else if (type == WIREFRAME) Wireframe::drawStrokedTriangle(window, flattened, Colour(255, 255, 255));
+			else if (type == RASTER) {
+				if (objects.loadedTriangles[triangleIndex].texturePoints[0] == -1) {
+					Rasterize::drawRasterizedTriangle(window, flattened, objects.loadedTriangles[triangleIndex].colour, zDepth);
+				}
+				else {
+					ModelTriangle texturedTriangle = objects.loadedTriangles[triangleIndex];
+					first.texturePoint = objects.loadedTextures[texturedTriangle.texturePoints[0]];
+					second.texturePoint = objects.loadedTextures[texturedTriangle.texturePoints[1]];
+					third.texturePoint = objects.loadedTextures[texturedTriangle.texturePoints[2]];
+					CanvasTriangle triangle = { first, second, third };
+					Rasterize::drawRasterizedTriangle(window, triangle, textures, zDepth);
+				}
 			}
 		}
 	}
 }
 
-std::vector<std::vector<uint32_t>> getRaytrace(Camera& camera, PolygonData& objects, TextureMap& textures, glm::vec3 lightPosition, std::set<std::string>& hiddenObjects) {
-	// create results canvas
-	std::vector<std::vector<uint32_t>> colorBuffer(HEIGHT, std::vector<uint32_t>(WIDTH));
-	std::vector<std::thread> threads;
-	// parallelise workload
-	
-	for (int i = 0; i < 4; i++) {
-		int startY = (HEIGHT >> 2) * i;
-		int endY = (HEIGHT >> 2) * (i + 1);
-		threads.emplace_back(Raytrace::renderSegment, glm::vec2{startY, endY}, std::ref(colorBuffer), std::ref(objects), std::ref(camera), std::ref(textures), lightPosition, std::ref(hiddenObjects));
-	}
-	for (auto& thread : threads) thread.join();
-	return colorBuffer;
+// where a mode's frames are traced to, how their tiles are handed out and traced, and what cuts them short. built
+// once per mode, the refinement passes only change the step
+struct RaytraceFrame {
+	const RenderTarget& target;
+	TileScheduler& scheduler;
+	TraceSettings settings;
+	Cancellation cancellation;
+};
+
+// returns false when the frame's cancellation went stale before every tile was traced. reprojection needs geometry and
+// full frames. the thread pool has to have been sized for the target already, this may run on one of its workers
+bool getRaytrace(Camera& camera, PolygonData& objects, TextureMap& textures, glm::vec3 lightPosition, const RaytraceFrame& frame, std::vector<std::vector<uint32_t>>& colorBuffer) {
+	const RenderTarget& target = frame.target;
+	GeometryBuffer* geometry = frame.settings.geometry;
+	ShadowAccumulation* shadows = frame.settings.shadows;
+	ReprojectionCache* reprojection = frame.settings.reprojection;
+	IrradianceCache* irradiance = frame.settings.irradiance;
+	// results canvas is kept between frames and only reallocated when the target changes size
+	target.fitBuffer(colorBuffer, 0u);
+	// a moving camera carries the last frame's colours over, before its hits are dropped
+	bool reprojecting = reprojection != nullptr && reprojection->reproject(*geometry, camera, target, lightPosition);
+	// primary hits survive light-only changes, anything that moves the primary rays drops them
+	if (geometry != nullptr) geometry->validate(camera, target, objects.accelerator.version);
+	// soft shadows keep converging over frames until the view or the light moves
+	if (shadows != nullptr) shadows->validate(*geometry, target, lightPosition);
+	// cached soft shadows serve every view until the light or the scene moves
+	if (irradiance != nullptr) irradiance->validate(objects, lightPosition);
+	TraceSettings tileSettings = frame.settings;
+	if (!reprojecting) tileSettings.reprojection = nullptr;
+	frame.scheduler.resize(target.width, target.height);
+	// parallelise workload, tiles are handed out as workers free up
+	bool traced = frame.scheduler.run([&](glm::ivec2 tileMin, glm::ivec2 tileMax) {
+		Raytrace::renderTile(tileMin, tileMax, target, colorBuffer, objects, camera, textures, lightPosition, tileSettings);
+	}, frame.cancellation);
+	// records of the tiles that did get traced are as good as any
+	if (irradiance != nullptr) irradiance->commit();
+	if (traced && reprojection != nullptr) reprojection->record(*geometry, colorBuffer, camera, target, lightPosition);
+	return traced;
 }
 
 float useGaussian(float value, float stddev) {
@@ -65,14 +106,14 @@ uint32_t packChannels(int red, int green, int blue) {
 	return (255 << 24) + (red << 16) + (green << 8) + blue;
 }
 
-void useBilteralFilter(glm::vec2 boundY, std::vector<std::vector<uint32_t>>& colorBuffer, std::vector<std::vector<uint32_t>>& output) {
+void useBilteralFilter(glm::vec2 boundY, const RenderTarget& target, std::vector<std::vector<uint32_t>>& colorBuffer, std::vector<std::vector<uint32_t>>& output) {
 	// apply bilateral filter algorithm
 	float sigmaSpace = 2;
 	float sigmaRange = 17;
 	int radius = int(2 * sigmaSpace);
 	
 	for (int y = boundY[0]; y < boundY[1]; y++) {
-		for (int x = 0; x < WIDTH; x++) {
+		for (int x = 0; x < target.width; x++) {
 			float sumOfWeights = 0;
 			float responseR = 0;
 			float responseG = 0;
@@ -85,7 +126,7 @@ void useBilteralFilter(glm::vec2 boundY, std::vector<std::vector<uint32_t>>& col
 					int nx = x + dx;
 					int ny = y + dy;
 
-					if (nx >= 0 && nx < WIDTH && ny >= 0 && ny < HEIGHT) {
+					if (nx >= 0 && nx < target.width && ny >= 0 && ny < target.height) {
 						int kernelR, kernelG, kernelB;
 						splitChannels(colorBuffer[ny][nx], kernelR, kernelG, kernelB);
 						float colorDist = glm::sqrt(
@@ -113,74 +154,177 @@ void useBilteralFilter(glm::vec2 boundY, std::vector<std::vector<uint32_t>>& col
 	}
 }
 
-void applyFilter(std::vector<std::vector<uint32_t>>& colorBuffer) {
-	std::vector<std::vector<uint32_t>> output(HEIGHT, std::vector<uint32_t>(WIDTH));
+// output is scratch space kept by the caller, it is swapped with colorBuffer instead of copied
+void applyFilter(std::vector<std::vector<uint32_t>>& colorBuffer, std::vector<std::vector<uint32_t>>& output, const RenderTarget& target) {
+	target.fitBuffer(output, 0u);
 	// parallelise workload here
-	std::vector<std::thread> threads;
-	for (int i = 0; i < 4; i++) {
-		int startY = (HEIGHT >> 2) * i;
-		int endY = (HEIGHT >> 2) * (i + 1);
-		threads.emplace_back(useBilteralFilter, glm::vec2{ startY, endY }, std::ref(colorBuffer), std::ref(output));
-	}
-	for (auto& thread : threads) thread.join();
-	colorBuffer = output;
+	int bandCount = (target.height + BAND_HEIGHT - 1) / BAND_HEIGHT;
+	threadPool.parallelFor(bandCount, [&](int band) {
+		int startY = band * BAND_HEIGHT;
+		int endY = glm::min(startY + BAND_HEIGHT, target.height);
+		useBilteralFilter(glm::vec2{ startY, endY }, target, colorBuffer, output);
+	});
+	colorBuffer.swap(output);
 }
 
 void renderBuffer(std::vector<std::vector<uint32_t>>& colorBuffer, DrawingWindow& window) {
-	for (int y = HEIGHT - 1; y > -1; y--) {
-		for (int x = 0; x < WIDTH; x++) {
+	for (int y = int(window.height) - 1; y > -1; y--) {
+		for (int x = 0; x < int(window.width); x++) {
 			window.setPixelColour(x, y, colorBuffer[y][x]);
 		}
 	}
 	window.renderFrame();
 }
 
-void handleEvent(SDL_Event event, DrawingWindow &window, Camera &camera, RenderType& renderer, glm::vec3& lightPosition) {
+// same format as DrawingWindow::savePPM, for frames that never go through the window
+void saveBufferPPM(const std::string& filename, std::vector<std::vector<uint32_t>>& colorBuffer, const RenderTarget& target) {
+	std::ofstream outputStream(filename, std::ofstream::out | std::ofstream::binary);
+	if (!outputStream.is_open()) {
+		std::cout << "Could not write " << filename << std::endl;
+		return;
+	}
+	outputStream << "P6\n";
+	outputStream << target.width << " " << target.height << "\n";
+	outputStream << "255\n";
+	std::vector<char> row(3 * target.width);
+	for (int y = 0; y < target.height; y++) {
+		for (int x = 0; x < target.width; x++) {
+			int red, green, blue;
+			splitChannels(colorBuffer[y][x], red, green, blue);
+			row[3 * x] = char(red);
+			row[3 * x + 1] = char(green);
+			row[3 * x + 2] = char(blue);
+		}
+		outputStream.write(row.data(), row.size());
+	}
+	outputStream.close();
+}
+
+// ray traces one frame at the still target, independent of the window, and writes it to filename
+void renderStill(const std::string& filename, Camera& camera, PolygonData& objects, TextureMap& textures, glm::vec3 lightPosition, const RenderTarget& still, VertexLighting& vertexLighting) {
+	TileScheduler stillScheduler(still.width, still.height);
+	// only called while no frame is in flight, so nothing is running on the pool
+	threadPool.resize(still.workerCount);
+	std::vector<std::vector<uint32_t>> colorBuffer;
+	std::vector<std::vector<uint32_t>> filterBuffer;
+	if (!lighting.usePhong) vertexLighting.update(objects, lightPosition, camera.cameraPosition);
+	// no caches, and nothing cuts it short
+	RaytraceFrame frame = { still, stillScheduler, TraceSettings(), { nullptr, 0 } };
+	getRaytrace(camera, objects, textures, lightPosition, frame, colorBuffer);
+	if (lighting.useSoftShadow && lighting.useFilter) applyFilter(colorBuffer, filterBuffer, still);
+	saveBufferPPM(filename, colorBuffer, still);
+	std::cout << "saved " << still.width << "x" << still.height << " still to " << filename << std::endl;
+}
+
+// applies an event to the input side view, returns whether view changed, which leaves the frame on screen and the one
+// in flight out of date. modeChanged is set when the renderer or the way frames are traced changes instead
+bool handleEvent(SDL_Event event, ViewState& view, RenderType& renderer, bool& modeChanged, bool& stillRequested, bool& showStageTimes, ProgressiveRefinement& refinement, FrameBudget& budget) {
 	if (event.type == SDL_KEYDOWN) {
+		bool viewChanged = true;
 		if (event.key.keysym.sym == SDLK_LEFT) {
-			if (renderer == RAYTRACE) lightPosition += glm::vec3(-0.25, 0, 0);
-			else camera.rotate(0, -1, 0);
+			if (renderer == RAYTRACE) view.lightPosition += glm::vec3(-0.25, 0, 0);
+			else view.camera.rotate(0, -1, 0);
 		}
 		else if (event.key.keysym.sym == SDLK_RIGHT) {
-			if (renderer == RAYTRACE) lightPosition += glm::vec3(0.25, 0, 0);
-			else camera.rotate(0, 1, 0);
+			if (renderer == RAYTRACE) view.lightPosition += glm::vec3(0.25, 0, 0);
+			else view.camera.rotate(0, 1, 0);
 		}
 		else if (event.key.keysym.sym == SDLK_UP) {
-			if (renderer == RAYTRACE) lightPosition += glm::vec3(0, 0.25, 0);
-			else camera.translate(glm::vec3(0, 0, -0.1));
+			if (renderer == RAYTRACE) view.lightPosition += glm::vec3(0, 0.25, 0);
+			else view.camera.translate(glm::vec3(0, 0, -0.1));
 		}
 		else if (event.key.keysym.sym == SDLK_DOWN) {
-			if (renderer == RAYTRACE) lightPosition += glm::vec3(0, -0.25, 0);
-			else camera.translate(glm::vec3(0, 0, 0.1));
+			if (renderer == RAYTRACE) view.lightPosition += glm::vec3(0, -0.25, 0);
+			else view.camera.translate(glm::vec3(0, 0, 0.1));
 		}
 		else if (event.key.keysym.sym == SDLK_w) {
-			if (renderer == RAYTRACE) lightPosition += glm::vec3(0, 0, -0.25);
-			else camera.translate(glm::vec3(0, 0.1, 0));
+			if (renderer == RAYTRACE) view.lightPosition += glm::vec3(0, 0, -0.25);
+			else view.camera.translate(glm::vec3(0, 0.1, 0));
 		}
 		else if (event.key.keysym.sym == SDLK_s) {
-			if (renderer == RAYTRACE) lightPosition += glm::vec3(0, 0, 0.25);
-			else camera.translate(glm::vec3(0, -0.1, 0));
+			if (renderer == RAYTRACE) view.lightPosition += glm::vec3(0, 0, 0.25);
+			else view.camera.translate(glm::vec3(0, -0.1, 0));
+		}
+		else if (event.key.keysym.sym == SDLK_a) view.camera.translate(glm::vec3(-0.1, 0, 0));
+		else if (event.key.keysym.sym == SDLK_d) view.camera.translate(glm::vec3(0.1, 0, 0));
+		// the rest are toggles, which a held key would flip back and forth
+		else if (event.key.repeat) viewChanged = false;
+		else if (event.key.keysym.sym >= SDLK_1 && event.key.keysym.sym <= SDLK_4) {
+			const RenderType renderers[] = { WIREFRAME, RASTER, POINTCLOUD, RAYTRACE };
+			RenderType chosen = renderers[event.key.keysym.sym - SDLK_1];
+			if (chosen != renderer) modeChanged = true;
+			renderer = chosen;
+			viewChanged = false;
+		}
+		else if (event.key.keysym.sym == SDLK_h) view.lighting.useShadow = !view.lighting.useShadow;
+		else if (event.key.keysym.sym == SDLK_m) view.lighting.useAmbience = !view.lighting.useAmbience;
+		else if (event.key.keysym.sym == SDLK_p) view.lighting.useProximity = !view.lighting.useProximity;
+		else if (event.key.keysym.sym == SDLK_i) view.lighting.useIncidence = !view.lighting.useIncidence;
+		else if (event.key.keysym.sym == SDLK_z) view.lighting.useSpecular = !view.lighting.useSpecular;
+		else if (event.key.keysym.sym == SDLK_v) {
+			view.lighting.useVertexShadows = !view.lighting.useVertexShadows;
+			std::cout << "vertex shadows: " << (view.lighting.useVertexShadows ? "on" : "off") << std::endl;
+		}
+		else if (event.key.keysym.sym == SDLK_c) {
+			view.lighting.useIrradianceCache = !view.lighting.useIrradianceCache;
+			std::cout << "irradiance cache: " << (view.lighting.useIrradianceCache ? "on" : "off") << std::endl;
+		}
+		else if (event.key.keysym.sym == SDLK_b) {
+			view.layout = BVHLayout((view.layout + 1) % (QUANTIZED_LAYOUT + 1));
+			const char* layoutNames[] = { "binary", "wide", "quantized" };
+			std::cout << "bvh nodes: " << layoutNames[view.layout] << std::endl;
+		}
+		else if (event.key.keysym.sym == SDLK_o) {
+			view.orderByCost = !view.orderByCost;
+			std::cout << "tile order: " << (view.orderByCost ? "by cost" : "morton") << std::endl;
+		}
+		else if (event.key.keysym.sym == SDLK_x) {
+			stillRequested = true;
+			viewChanged = false;
+		}
+		else if (event.key.keysym.sym == SDLK_f) {
+			showStageTimes = !showStageTimes;
+			viewChanged = false;
 		}
-		else if (event.key.keysym.sym == SDLK_a) camera.translate(glm::vec3(-0.1, 0, 0));
-		else if (event.key.keysym.sym == SDLK_d) camera.translate(glm::vec3(0.1, 0, 0));
-		else if (event.key.keysym.sym == SDLK_1) renderer = WIREFRAME;
-		else if (event.key.keysym.sym == SDLK_2) renderer = RASTER;
-		else if (event.key.keysym.sym == SDLK_3) renderer = POINTCLOUD;
-		else if (event.key.keysym.sym == SDLK_4) renderer = RAYTRACE;
-		else if (event.key.keysym.sym == SDLK_h) lighting.useShadow = !lighting.useShadow;
-		else if (event.key.keysym.sym == SDLK_m) lighting.useAmbience = !lighting.useAmbience;
-		else if (event.key.keysym.sym == SDLK_p) lighting.useProximity = !lighting.useProximity;
-		else if (event.key.keysym.sym == SDLK_i) lighting.useIncidence = !lighting.useIncidence;
-		else if (event.key.keysym.sym == SDLK_z) lighting.useSpecular = !lighting.useSpecular;
+		else if (event.key.keysym.sym == SDLK_r) {
+			refinement.enabled = !refinement.enabled;
+			std::cout << "progressive refinement: " << (refinement.enabled ? "on" : "off") << std::endl;
+			modeChanged = true;
+			viewChanged = false;
+		}
+		else if (event.key.keysym.sym == SDLK_t) {
+			budget.enabled = !budget.enabled;
+			std::cout << "frame budget: " << (budget.enabled ? std::to_string(int(budget.targetMilliseconds)) + "ms" : "off") << std::endl;
+			modeChanged = true;
+			viewChanged = false;
+		}
+		else viewChanged = false;
+		return viewChanged;
 	} else if (event.type == SDL_MOUSEBUTTONDOWN) {
 		int x, y;
 		SDL_GetMouseState(&x, &y);
 		std::cout << "{ x: " << x << ", y: " << y << " }" << std::endl;
 	}
+	return false;
 }
 
+// usage: RedNoise [width height [workers [stillWidth stillHeight]]]
 int main(int argc, char *argv[]) {
-	DrawingWindow window = DrawingWindow(WIDTH, HEIGHT, false);
+	int width = argc > 2 ? std::atoi(argv[1]) : DEFAULT_WIDTH;
+	int height = argc > 2 ? std::atoi(argv[2]) : DEFAULT_HEIGHT;
+	int workers = argc > 3 ? std::atoi(argv[3]) : std::thread::hardware_concurrency();
+	if (width < 1 || height < 1) {
+		std::cout << "invalid resolution, using " << DEFAULT_WIDTH << "x" << DEFAULT_HEIGHT << std::endl;
+		width = DEFAULT_WIDTH;
+		height = DEFAULT_HEIGHT;
+	}
+	// the window shows the preview, stills are rendered offscreen at their own size
+	RenderTarget preview(width, height, workers);
+	RenderTarget still = argc > 5 ? RenderTarget(std::atoi(argv[4]), std::atoi(argv[5]), workers) : RenderTarget(3840, 2160, workers);
+	if (still.width < 1 || still.height < 1) still = RenderTarget(3840, 2160, workers);
+	threadPool.resize(preview.workerCount);
+
+	DrawingWindow window = DrawingWindow(preview.width, preview.height, false);
 	SDL_Event event;
 
 	CanvasTriangle triangle(CanvasPoint(160, 10), CanvasPoint(300, 230), CanvasPoint(10, 150));
@@ -197,40 +341,77 @@ int main(int argc, char *argv[]) {
 	fr.appendPolygonData(objects, "sphere.obj");
 	if (objects.loadedTriangles.empty()) return -1;
 	
-	glm::vec3 sceneMin(std::numeric_limits<float>::min());
-	glm::vec3 sceneMax(std::numeric_limits<float>::max());
-	for (int triangleIndex = 0; triangleIndex < objects.loadedTriangles.size(); triangleIndex++) {
-		glm::vec3 v0 = objects.getTriangleVertexPosition(triangleIndex, 0);
-		glm::vec3 v1 = objects.getTriangleVertexPosition(triangleIndex, 1);
-		glm::vec3 v2 = objects.getTriangleVertexPosition(triangleIndex, 2);
-		// calculate normals
-		glm::vec3 e0 = v1 - v0;
-		glm::vec3 e1 = v2 - v0;
-		objects.loadedTriangles[triangleIndex].normal = glm::normalize(glm::cross(e0, e1));
-
-		// calculate the bounding box for raytrace optimisation
-		glm::vec3 minBound = glm::min(v0, v1, v2);
-		glm::vec3 maxBound = glm::max(v0, v1, v2);
-		objects.loadedTriangles[triangleIndex].boundingMinMax = {minBound, maxBound};
-		sceneMax = glm::max(sceneMax, maxBound);
-		sceneMin = glm::min(sceneMin, minBound);
-	}
-	objects.sceneBoundingMinMax = { sceneMin, sceneMax };
-	
-	// normalise all vertex normal sums.
-	for (auto& entry : objects.vertexToTriangles) {
-		glm::vec3 vertexNormal = { 0,0,0 };
-		int vertexIndex = entry.first;
-		std::set<int> triangleIndices = entry.second;
-		for (int triangleIndex : triangleIndices) {
-			vertexNormal += objects.loadedTriangles[triangleIndex].normal;
-		}
-		objects.loadedVertices[vertexIndex].normal = glm::normalize(vertexNormal);
+	// normals, bounds and the accelerator only depend on the files and load parameters, so they are cached next to the OBJ
+	uint64_t sceneKey = SceneCache::hashScene({ "textured-cornell-box.obj", "sphere.obj", "textured-cornell-box.mtl" }, 0.35, { textures.width, textures.height });
+	if (!SceneCache::load("textured-cornell-box.obj.cache", sceneKey, objects)) {
+		objects.computeTriangleGeometry();
+		objects.accelerator.build(objects);
+		SceneCache::save("textured-cornell-box.obj.cache", sceneKey, objects);
 	}
+	// the sphere sits off centre in the box, moved there through the same refit an animation would use
+	objects.translateObject("red_sphere", { -0.5, -1.2, 0.3 });
+	std::cout << "triangle kernel: " << getTriangleKernelName(activeTriangleKernel) << std::endl;
+	std::cout << "bvh node memory: binary " << objects.accelerator.nodeMemory(BINARY_LAYOUT) <<
+		" bytes, wide " << objects.accelerator.nodeMemory(WIDE_LAYOUT) <<
+		" bytes, quantized " << objects.accelerator.nodeMemory(QUANTIZED_LAYOUT) << " bytes" << std::endl;
 
 	RenderType renderer = RASTER;
+	TileScheduler tileScheduler(preview.width, preview.height);
+	// every frame that lands wakes the main loop through the event queue it sleeps on
+	const Uint32 frameLandedEvent = SDL_RegisterEvents(1);
+	FramePipeline pipeline([frameLandedEvent] {
+		SDL_Event landed = {};
+		landed.type = frameLandedEvent;
+		SDL_PushEvent(&landed);
+	});
+	std::vector<std::vector<uint32_t>> filterBuffer;
+	std::vector<std::vector<uint32_t>> jobFilterBuffer; // scratch of the frame in flight, filterBuffer belongs to the main thread
+	bool inFlightNeedsFilter = false;
+	// stages of the frame in flight, only touched by the pipeline until it lands
+	TaskGraph frameGraph;
+	bool showStageTimes = false;
+	LightVisibility lightVisibility;
+	VertexLighting vertexLighting;
+	auto addGouraudStage = [&](Camera& frameCamera, glm::vec3& frameLight) {
+		if (lighting.usePhong) return;
+		frameGraph.add("gouraud", {}, { "vertices" }, [&] {
+			vertexLighting.update(objects, frameLight, frameCamera.cameraPosition);
+		});
+		if (!lighting.useVertexShadows) return;
+		frameGraph.add("visibility", {}, { "visibility" }, [&] { lightVisibility.update(objects, frameLight); });
+	};
+	std::vector<std::vector<float>> zDepth;
+	bool stillRequested = false;
+	ProgressiveRefinement refinement;
+	FrameBudget budget(33);
+	std::vector<std::vector<uint32_t>> budgetBuffer;
+	GeometryBuffer geometry; // primary hits shared by every mode, only touched by the frame in flight
+	ShadowAccumulation shadowSamples; // likewise, for the modes that trace every pixel every frame
+	ReprojectionCache reprojection; // likewise
+	IrradianceCache irradiance; // likewise, shared by every mode
+	// the caches of the modes that trace every pixel every frame. refinement traces each pixel once, so it has no
+	// samples to accumulate and no last frame to reproject
+	TraceSettings fullFrames;
+	fullFrames.geometry = &geometry;
+	fullFrames.shadows = &shadowSamples;
+	fullFrames.reprojection = &reprojection;
+	fullFrames.visibility = &lightVisibility;
+	fullFrames.irradiance = &irradiance;
+	TraceSettings refinementPasses = fullFrames;
+	refinementPasses.shadows = nullptr;
+	refinementPasses.reprojection = nullptr;
 	glm::vec3 lightPosition = { 0, 0.5, 0.75 };
 
+	// input edits view as events arrive and bumps inputEpoch, the loop publishes view to the state frames read
+	// once no frame is in flight
+	ViewState view = { camera, lightPosition, lighting, objects.accelerator.layout, tileScheduler.orderByCost };
+	std::atomic<unsigned> inputEpoch(0);
+	unsigned publishedEpoch = 0;
+	bool modeChanged = true; // nothing has been drawn yet
+	auto handleInput = [&](const SDL_Event& input) {
+		if (handleEvent(input, view, renderer, modeChanged, stillRequested, showStageTimes, refinement, budget)) inputEpoch++;
+	};
+
 	bool isCameraMoving = true;
 	float progression = 0;
 	int stage = 0;
@@ -240,25 +421,134 @@ int main(int argc, char *argv[]) {
 	// commented out bits are for the animation used in the final video submission
 	while (isCameraMoving) {
 		// We MUST poll for events - otherwise the window will freeze !
-		if (window.pollForInputEvents(event)) handleEvent(event, window, camera, renderer, lightPosition);
+		// the whole queue is drained every iteration, also while a frame traces. workers see the new epoch at
+		// their next tile and abandon the frame in flight
+		while (window.pollForInputEvents(event)) handleInput(event);
+		// the frame in flight reads the published state, so nothing is published or drawn until it lands. the loop
+		// sleeps on the event queue meanwhile, which the landing frame posts to
+		if (pipeline.isBusy() && !pipeline.isReady()) {
+			if (window.waitForInputEvents(event, IDLE_WAIT_MILLISECONDS)) handleInput(event);
+			continue;
+		}
+		std::vector<std::vector<uint32_t>>* tracedFrame = nullptr;
+		bool tracedNeedsFilter = inFlightNeedsFilter;
+		if (pipeline.isBusy()) {
+			tracedFrame = &pipeline.finish();
+			// started for a view that has changed since, so it was cut short
+			if (pipeline.getFrameEpoch() != inputEpoch) tracedFrame = nullptr;
+			else if (showStageTimes) {
+				for (const auto& timing : frameGraph.getTimings()) std::cout << timing.first << " " << timing.second << "ms  ";
+				std::cout << std::endl;
+			}
+		}
+		bool redraw = modeChanged;
+		if (publishedEpoch != inputEpoch) {
+			redraw = true;
+			publishedEpoch = inputEpoch;
+			camera = view.camera;
+			lightPosition = view.lightPosition;
+			lighting = view.lighting;
+			objects.accelerator.layout = view.layout;
+			tileScheduler.orderByCost = view.orderByCost;
+			refinement.restart();
+		}
+		// a new mode starts its own image over rather than leave the last one's on screen
+		if (modeChanged) refinement.restart();
+		modeChanged = false;
+		Cancellation cancellation = { &inputEpoch, publishedEpoch };
+
 		// camera.useAnimation(progression, stage, renderer, hiddenObjects, lighting, isCameraMoving, lightPosition);
 		// std::cout << "stage: " << stage << ", progression: " << progression << std::endl;
 		camera.lookAt({ 0,0,0 });
+		objects.accelerator.setHiddenObjects(hiddenObjects);
+		if (stillRequested) {
+			renderStill("still.ppm", camera, objects, textures, lightPosition, still, vertexLighting);
+			stillRequested = false;
+		}
+		// resizing joins every worker, which is only safe here, between the last frame landing and the next submit
+		threadPool.resize(preview.workerCount);
 		if (renderer == RAYTRACE) {
-			if (!lighting.usePhong) {
-				Raytrace::preprocessGouraud(objects, lightPosition, camera.cameraPosition);
+			// every mode runs its stages as a task graph on the pipeline, from a copy of the camera and light. the
+			// next frame is submitted before the last one is shown, so that its Gouraud lighting and trace overlap
+			// the last one's filter and present
+			bool refining = !budget.enabled && refinement.enabled;
+			bool filtering = lighting.useSoftShadow && lighting.useFilter;
+			inFlightNeedsFilter = false;
+			if (budget.enabled) {
+				// traced below the window's resolution when frames run over budget, then upsampled along the geometry
+				RenderTarget internal = budget.getInternalTarget(preview);
+				pipeline.submit(publishedEpoch, [&, camera, lightPosition, internal, cancellation, filtering](std::vector<std::vector<uint32_t>>& frameBuffer) mutable {
+					RaytraceFrame frame = { internal, tileScheduler, fullFrames, cancellation };
+					auto frameStart = std::chrono::steady_clock::now();
+					bool traced = false;
+					frameGraph.clear();
+					addGouraudStage(camera, lightPosition);
+					frameGraph.add("trace", { "vertices", "visibility" }, { "colour", "geometry", "shadows", "history", "irradiance" }, [&] {
+						traced = getRaytrace(camera, objects, textures, lightPosition, frame, budgetBuffer);
+					});
+					if (filtering) {
+						frameGraph.add("filter", { "colour" }, { "colour" }, [&] { applyFilter(budgetBuffer, jobFilterBuffer, internal); });
+					}
+					frameGraph.add("upsample", { "colour", "geometry" }, { "frame" }, [&] {
+						Upsample::edgeAware(internal, budgetBuffer, geometry, preview, frameBuffer);
+					});
+					frameGraph.run();
+					if (traced) budget.update(std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - frameStart).count());
+				});
 			}
-			auto colorBuffer = getRaytrace(camera, objects, textures, lightPosition, hiddenObjects);
-			if (lighting.useSoftShadow && lighting.useFilter) {
-				applyFilter(colorBuffer);
+			else if (refining) {
+				// a converged frame stays on screen until the next input event
+				if (!refinement.isComplete()) {
+					pipeline.submit(publishedEpoch, [&, camera, lightPosition, cancellation, filtering](std::vector<std::vector<uint32_t>>& frameBuffer) mutable {
+						RaytraceFrame frame = { preview, tileScheduler, refinementPasses, cancellation };
+						frameGraph.clear();
+						if (refinement.isStarting()) addGouraudStage(camera, lightPosition);
+						frameGraph.add("trace", { "vertices", "visibility" }, { "frame", "geometry", "irradiance" }, [&] {
+							// every pixel is only traced by one pass, so it gets its soft shadow samples all at once
+							refinement.refine(preview, frameBuffer, [&](std::vector<std::vector<uint32_t>>& samples, int step, bool skipCoarser) {
+								frame.settings.step = step;
+								frame.settings.skipCoarser = skipCoarser;
+								getRaytrace(camera, objects, textures, lightPosition, frame, samples);
+							});
+						});
+						// the filter only runs on the full resolution pass, the blocky passes would smear into it
+						frameGraph.add("filter", { "frame" }, { "frame" }, [&] {
+							if (refinement.isComplete() && filtering) applyFilter(frameBuffer, jobFilterBuffer, preview);
+						});
+						frameGraph.run();
+					});
+				}
+			}
+			else {
+				pipeline.submit(publishedEpoch, [&, camera, lightPosition, cancellation](std::vector<std::vector<uint32_t>>& colorBuffer) mutable {
+					RaytraceFrame frame = { preview, tileScheduler, fullFrames, cancellation };
+					frameGraph.clear();
+					addGouraudStage(camera, lightPosition);
+					frameGraph.add("trace", { "vertices", "visibility" }, { "frame", "geometry", "shadows", "history", "irradiance" }, [&] {
+						getRaytrace(camera, objects, textures, lightPosition, frame, colorBuffer);
+					});
+					frameGraph.run();
+				});
+				// filtered on this thread while the next frame traces
+				inFlightNeedsFilter = true;
+			}
+			if (tracedFrame != nullptr) {
+				if (tracedNeedsFilter && lighting.useSoftShadow && lighting.useFilter) {
+					applyFilter(*tracedFrame, filterBuffer, preview);
+				}
+				renderBuffer(*tracedFrame, window);
 			}
-			renderBuffer(colorBuffer, window);
 		}
-		else drawInterpolationRenders(window, camera, objects, renderer, textures, hiddenObjects);
+		else if (redraw) drawInterpolationRenders(window, camera, objects, renderer, textures, preview, zDepth);
 		// Need to render the frame at the end, or nothing actually gets shown on the screen !
 		// std::string frameString = std::to_string(frame++);
 		// std::string filename = "xframe" + std::string(4 - std::min(4, int(frameString.length())), '0') + frameString + ".bmp";
 		window.renderFrame();
+		// nothing in flight and nothing new to show, such as a converged refinement or an unchanged raster view, so
+		// the loop sleeps until input arrives rather than spin
+		if (!pipeline.isBusy() && tracedFrame == nullptr && !redraw) {
+			if (window.waitForInputEvents(event, IDLE_WAIT_MILLISECONDS)) handleInput(event);
+		}
 		// try {
 		// 	window.saveBMP("./renders/" + filename);
 		// 	std::cout << "rendered frame " << frame << std::endl;
@@ -0,0 +1,5 @@
+#include "RenderTarget.h"
+#include "Constants.h"
+
+RenderTarget::RenderTarget(int width, int height, int workerCount) :
+	width(width), height(height), focalLength(2.0f), scale(180.0f * height / DEFAULT_HEIGHT), workerCount(workerCount) {}
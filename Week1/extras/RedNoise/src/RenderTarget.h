@@ -0,0 +1,23 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+
+// what a frame is rendered into. every render path reads its resolution and projection from here
+struct RenderTarget {
+	int width;
+	int height;
+	float focalLength;
+	float scale; // pixels per unit of the image plane
+	int workerCount; // threads the pool renders with
+
+	// the scale grows with the height, so every resolution frames the scene the same way
+	RenderTarget(int width, int height, int workerCount);
+
+	// resizes a per-frame buffer to the target, keeping its storage and contents when the size is unchanged.
+	// pixels that did not exist before are set to fill
+	template <typename T>
+	void fitBuffer(std::vector<std::vector<T>>& buffer, T fill) const {
+		buffer.resize(height);
+		for (auto& row : buffer) row.resize(width, fill);
+	}
+};
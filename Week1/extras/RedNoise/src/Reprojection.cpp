@@ -0,0 +1,64 @@
+#include "Reprojection.h"
+#include "Wireframe.h"
+
+namespace {
+	// how far the new hit may be from the carried one, relative to its distance
+	const float DEPTH_TOLERANCE = 0.01f;
+	// cosine of the largest angle between the carried and new interpolated normals
+	const float NORMAL_TOLERANCE = 0.99f;
+}
+
+void ReprojectionCache::record(const GeometryBuffer& geometry, const std::vector<std::vector<uint32_t>>& colorBuffer, Camera& camera,
+	const RenderTarget& target, glm::vec3 light) {
+	target.fitBuffer(colours, 0u);
+	for (int y = 0; y < target.height; y++) std::copy(colorBuffer[y].begin(), colorBuffer[y].begin() + target.width, colours[y].begin());
+	recorded = true;
+	geometryGeneration = geometry.getGeneration();
+	cameraPosition = camera.cameraPosition;
+	viewMatrix = camera.viewMatrix;
+	width = target.width;
+	height = target.height;
+	lightOrigin = light;
+	recordedLighting = lighting;
+}
+
+bool ReprojectionCache::reproject(const GeometryBuffer& geometry, Camera& camera, const RenderTarget& target, glm::vec3 light) {
+	if (!recorded || geometry.getGeneration() != geometryGeneration) return false;
+	if (light != lightOrigin || lighting != recordedLighting) return false;
+	bool moved = camera.cameraPosition != cameraPosition || camera.viewMatrix != viewMatrix || target.width != width || target.height != height;
+	if (!moved) return false;
+	frameIndex++;
+
+	ReprojectedSample empty = { -1, std::numeric_limits<float>::max(), glm::vec3(0), 0 };
+	target.fitBuffer(samples, empty);
+	for (auto& row : samples) std::fill(row.begin(), row.end(), empty);
+	// splatted one hit at a time, keeping the closest of those that land in the same pixel. serial, since
+	// neighbouring source rows land in the same destination rows
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			const PrimaryHit& hit = geometry.hits[y][x];
+			if (hit.triangleIndex < 0) continue;
+			CanvasPoint point = Wireframe::canvasIntersection(camera, hit.position, target, camera.viewMatrix);
+			// behind the new camera
+			if (point.depth >= 0) continue;
+			int newX = int(glm::round(point.x));
+			int newY = int(glm::round(point.y));
+			if (newX < 0 || newX >= target.width || newY < 0 || newY >= target.height) continue;
+			float distance = glm::distance(camera.cameraPosition, hit.position);
+			ReprojectedSample& sample = samples[newY][newX];
+			if (distance >= sample.distance) continue;
+			sample = { hit.triangleIndex, distance, hit.interpolatedNormal, colours[y][x] };
+		}
+	}
+	return true;
+}
+
+bool ReprojectionCache::lookup(glm::ivec2 pixel, int triangleIndex, float distance, glm::vec3 normal, uint32_t& colour) const {
+	if ((pixel.x + 3 * pixel.y + frameIndex) % REFRESH_INTERVAL == 0) return false;
+	const ReprojectedSample& sample = samples[pixel.y][pixel.x];
+	if (sample.triangleIndex != triangleIndex) return false;
+	if (glm::abs(sample.distance - distance) > DEPTH_TOLERANCE * distance) return false;
+	if (glm::dot(sample.normal, normal) < NORMAL_TOLERANCE) return false;
+	colour = sample.colour;
+	return true;
+}
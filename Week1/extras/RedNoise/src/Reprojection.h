@@ -0,0 +1,52 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "Camera.h"
+#include "Lighting.h"
+#include "RenderTarget.h"
+#include "Raytrace.h"
+
+// every this many frames a pixel is shaded again even when its reprojected colour still matches
+const int REFRESH_INTERVAL = 8;
+
+// a shaded colour carried over from the last frame into a pixel of the new view
+struct ReprojectedSample {
+	int triangleIndex; // -1 where nothing landed in the pixel
+	float distance; // from the new camera
+	glm::vec3 normal; // interpolated
+	uint32_t colour;
+};
+
+// shaded colours of the last completed frame. while the camera moves they are carried into the new view, and
+// every pixel whose primary ray lands on the same surface keeps its colour instead of being shaded again. the
+// rest are disocclusions, plus a rotating subset that keeps view dependent shading from going stale
+class ReprojectionCache {
+private:
+	std::vector<std::vector<uint32_t>> colours; // of the recorded frame, before filtering
+	bool recorded = false;
+	unsigned geometryGeneration = 0; // generation of the hits the colours were shaded for
+	glm::vec3 cameraPosition;
+	glm::mat3 viewMatrix;
+	int width = 0;
+	int height = 0;
+	glm::vec3 lightOrigin;
+	Lighting recordedLighting{ false, false, false, false, false, false }; // set by record, before anything reads it
+	int frameIndex = 0;
+
+public:
+	std::vector<std::vector<ReprojectedSample>> samples; // for the frame being traced
+
+	// keeps colorBuffer as the last frame, every pixel of it has to have been traced into geometry
+	void record(const GeometryBuffer& geometry, const std::vector<std::vector<uint32_t>>& colorBuffer, Camera& camera,
+		const RenderTarget& target, glm::vec3 lightOrigin);
+
+	// carries the recorded colours into camera's view of target. has to run before geometry is validated for camera,
+	// while it still holds the recorded hits. false when there is nothing to carry over, because nothing was recorded
+	// for those hits, the lighting changed or the view did not move
+	bool reproject(const GeometryBuffer& geometry, Camera& camera, const RenderTarget& target, glm::vec3 lightOrigin);
+
+	// the carried colour of pixel, when its new primary hit passes the triangle, depth and normal tests and it is
+	// not due to be refreshed
+	bool lookup(glm::ivec2 pixel, int triangleIndex, float distance, glm::vec3 normal, uint32_t& colour) const;
+};
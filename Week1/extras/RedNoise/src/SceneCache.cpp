@@ -0,0 +1,255 @@
+#include "SceneCache.h"
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <cstring>
+
+namespace {
+	const char CACHE_MAGIC[8] = { 'R', 'N', 'C', 'A', 'C', 'H', 'E', '\0' };
+	// bump whenever the meaning of the cached data changes, struct size changes are caught by the header
+	const uint32_t CACHE_VERSION = 3;
+	const uint64_t FNV_OFFSET = 14695981039346656037ull;
+	const uint64_t FNV_PRIME = 1099511628211ull;
+	const int ALIGNMENT = 16;
+
+	struct CacheHeader {
+		char magic[8];
+		uint32_t version;
+		uint32_t nodeSize;
+		uint32_t recordSize;
+		uint32_t packetSize;
+		uint32_t wideNodeSize;
+		uint32_t quantizedNodeSize;
+		uint64_t sceneKey;
+		uint64_t triangleCount;
+		uint64_t vertexCount;
+		uint64_t instanceCount;
+	};
+
+	CacheHeader makeHeader(uint64_t sceneKey, PolygonData& objects) {
+		CacheHeader header = {};
+		std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+		header.version = CACHE_VERSION;
+		header.nodeSize = sizeof(BVHNode);
+		header.recordSize = sizeof(TriangleRecord);
+		header.packetSize = sizeof(TrianglePacket);
+		header.wideNodeSize = sizeof(WideBVHNode);
+		header.quantizedNodeSize = sizeof(QuantizedBVHNode);
+		header.sceneKey = sceneKey;
+		header.triangleCount = objects.loadedTriangles.size();
+		header.vertexCount = objects.loadedVertices.size();
+		header.instanceCount = objects.accelerator.instances.size();
+		return header;
+	}
+
+	uint64_t hashBytes(uint64_t hash, const char* bytes, size_t count) {
+		for (size_t i = 0; i < count; i++) {
+			hash ^= uint8_t(bytes[i]);
+			hash *= FNV_PRIME;
+		}
+		return hash;
+	}
+
+	class CacheWriter {
+	private:
+		std::ofstream& stream;
+		uint64_t offset = 0;
+
+	public:
+		explicit CacheWriter(std::ofstream& stream) : stream(stream) {}
+
+		void writeBytes(const void* bytes, size_t count) {
+			stream.write(static_cast<const char*>(bytes), count);
+			offset += count;
+		}
+
+		// every array starts on an aligned offset so that the file can be used in place once mapped
+		void alignTo() {
+			const char zeros[ALIGNMENT] = {};
+			writeBytes(zeros, (ALIGNMENT - offset % ALIGNMENT) % ALIGNMENT);
+		}
+
+		template <typename T>
+		void writeArray(const std::vector<T>& values) {
+			uint64_t count = values.size();
+			writeBytes(&count, sizeof(count));
+			alignTo();
+			if (count > 0) writeBytes(values.data(), count * sizeof(T));
+			alignTo();
+		}
+
+		void writeString(const std::string& value) {
+			writeArray(std::vector<char>(value.begin(), value.end()));
+		}
+
+		void writeTree(const BoundingVolumeHierarchy& bvh) {
+			writeBytes(&bvh.builtCost, sizeof(bvh.builtCost));
+			writeArray(bvh.nodes);
+			writeArray(bvh.primitiveIndices);
+			writeArray(bvh.records);
+			writeArray(bvh.packets);
+			writeArray(bvh.leafPackets);
+			writeArray(bvh.wideNodes);
+			writeArray(bvh.quantizedNodes);
+			writeArray(bvh.packetFirst);
+		}
+	};
+
+	class CacheReader {
+	private:
+		const std::vector<char>& bytes;
+		uint64_t offset = 0;
+
+	public:
+		bool valid = true;
+
+		explicit CacheReader(const std::vector<char>& bytes) : bytes(bytes) {}
+
+		void readBytes(void* destination, size_t count) {
+			if (!valid || count > bytes.size() - offset) {
+				valid = false;
+				return;
+			}
+			std::memcpy(destination, bytes.data() + offset, count);
+			offset += count;
+		}
+
+		void alignTo() {
+			offset += (ALIGNMENT - offset % ALIGNMENT) % ALIGNMENT;
+			if (offset > bytes.size()) valid = false;
+		}
+
+		template <typename T>
+		void readArray(std::vector<T>& values) {
+			uint64_t count = 0;
+			readBytes(&count, sizeof(count));
+			alignTo();
+			if (!valid || count > (bytes.size() - offset) / sizeof(T)) {
+				valid = false;
+				return;
+			}
+			values.resize(count);
+			if (count > 0) readBytes(values.data(), count * sizeof(T));
+			alignTo();
+		}
+
+		void readString(std::string& value) {
+			std::vector<char> characters;
+			readArray(characters);
+			value.assign(characters.begin(), characters.end());
+		}
+
+		void readTree(BoundingVolumeHierarchy& bvh) {
+			readBytes(&bvh.builtCost, sizeof(bvh.builtCost));
+			readArray(bvh.nodes);
+			readArray(bvh.primitiveIndices);
+			readArray(bvh.records);
+			readArray(bvh.packets);
+			readArray(bvh.leafPackets);
+			readArray(bvh.wideNodes);
+			readArray(bvh.quantizedNodes);
+			readArray(bvh.packetFirst);
+		}
+	};
+}
+
+uint64_t SceneCache::hashScene(const std::vector<std::string>& filenames, float scaleFactor, glm::vec2 textureScales) {
+	uint64_t hash = FNV_OFFSET;
+	for (const std::string& filename : filenames) {
+		std::ifstream inputStream(filename, std::ios::binary);
+		std::vector<char> contents((std::istreambuf_iterator<char>(inputStream)), std::istreambuf_iterator<char>());
+		uint64_t size = contents.size();
+		hash = hashBytes(hash, filename.data(), filename.size());
+		hash = hashBytes(hash, reinterpret_cast<const char*>(&size), sizeof(size));
+		hash = hashBytes(hash, contents.data(), contents.size());
+	}
+	hash = hashBytes(hash, reinterpret_cast<const char*>(&scaleFactor), sizeof(scaleFactor));
+	hash = hashBytes(hash, reinterpret_cast<const char*>(&textureScales), sizeof(textureScales));
+	return hash;
+}
+
+bool SceneCache::load(const std::string& filename, uint64_t sceneKey, PolygonData& objects) {
+	std::ifstream inputStream(filename, std::ios::binary);
+	if (!inputStream.is_open()) return false;
+	std::vector<char> bytes((std::istreambuf_iterator<char>(inputStream)), std::istreambuf_iterator<char>());
+	inputStream.close();
+
+	CacheReader reader(bytes);
+	CacheHeader header;
+	reader.readBytes(&header, sizeof(header));
+	CacheHeader expected = makeHeader(sceneKey, objects);
+	// the instance count is only known after reading, so it is left out of the comparison
+	expected.instanceCount = header.instanceCount;
+	if (!reader.valid || std::memcmp(&header, &expected, sizeof(header)) != 0) {
+		std::cout << "scene cache is stale, rebuilding" << std::endl;
+		return false;
+	}
+	reader.alignTo();
+
+	std::vector<glm::vec3> triangleGeometry; // normal, bounds min and bounds max of every triangle
+	std::vector<glm::vec3> vertexNormals;
+	std::vector<glm::vec3> sceneBounds;
+	reader.readArray(triangleGeometry);
+	reader.readArray(vertexNormals);
+	reader.readArray(sceneBounds);
+	std::vector<ObjectInstance> instances(header.instanceCount);
+	for (ObjectInstance& instance : instances) {
+		reader.readString(instance.objectName);
+		reader.readTree(instance.bvh);
+		instance.visible = true;
+	}
+	BoundingVolumeHierarchy topLevel;
+	reader.readTree(topLevel);
+	if (!reader.valid || triangleGeometry.size() != 3 * header.triangleCount ||
+		vertexNormals.size() != header.vertexCount || sceneBounds.size() != 2) {
+		std::cout << "scene cache is corrupt, rebuilding" << std::endl;
+		return false;
+	}
+
+	for (int triangleIndex = 0; triangleIndex < int(objects.loadedTriangles.size()); triangleIndex++) {
+		ModelTriangle& triangle = objects.loadedTriangles[triangleIndex];
+		triangle.normal = triangleGeometry[3 * triangleIndex];
+		triangle.boundingMinMax = { triangleGeometry[3 * triangleIndex + 1], triangleGeometry[3 * triangleIndex + 2] };
+	}
+	for (int vertexIndex = 0; vertexIndex < int(objects.loadedVertices.size()); vertexIndex++) {
+		objects.loadedVertices[vertexIndex].normal = vertexNormals[vertexIndex];
+	}
+	objects.sceneBoundingMinMax = { sceneBounds[0], sceneBounds[1] };
+	objects.accelerator.instances = std::move(instances);
+	objects.accelerator.topLevel = std::move(topLevel);
+	objects.accelerator.version++;
+	return true;
+}
+
+void SceneCache::save(const std::string& filename, uint64_t sceneKey, PolygonData& objects) {
+	std::ofstream outputStream(filename, std::ios::binary | std::ios::trunc);
+	if (!outputStream.is_open()) {
+		std::cout << "Could not write scene cache" << std::endl;
+		return;
+	}
+
+	std::vector<glm::vec3> triangleGeometry;
+	triangleGeometry.reserve(3 * objects.loadedTriangles.size());
+	for (const ModelTriangle& triangle : objects.loadedTriangles) {
+		triangleGeometry.push_back(triangle.normal);
+		triangleGeometry.push_back(triangle.boundingMinMax.first);
+		triangleGeometry.push_back(triangle.boundingMinMax.second);
+	}
+	std::vector<glm::vec3> vertexNormals;
+	vertexNormals.reserve(objects.loadedVertices.size());
+	for (const GouraudVertex& vertex : objects.loadedVertices) vertexNormals.push_back(vertex.normal);
+
+	CacheWriter writer(outputStream);
+	CacheHeader header = makeHeader(sceneKey, objects);
+	writer.writeBytes(&header, sizeof(header));
+	writer.alignTo();
+	writer.writeArray(triangleGeometry);
+	writer.writeArray(vertexNormals);
+	writer.writeArray(std::vector<glm::vec3>{ objects.sceneBoundingMinMax.first, objects.sceneBoundingMinMax.second });
+	for (const ObjectInstance& instance : objects.accelerator.instances) {
+		writer.writeString(instance.objectName);
+		writer.writeTree(instance.bvh);
+	}
+	writer.writeTree(objects.accelerator.topLevel);
+	outputStream.close();
+}
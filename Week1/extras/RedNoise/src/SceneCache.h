@@ -0,0 +1,17 @@
+#pragma once
+#include <PolygonData.h>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace SceneCache {
+	// hashes the bytes of every file the scene is loaded from together with the parameters they are loaded with
+	uint64_t hashScene(const std::vector<std::string>& filenames, float scaleFactor, glm::vec2 textureScales);
+
+	// restores the derived triangle geometry and the built accelerator of freshly parsed objects.
+	// returns false, leaving objects untouched, when the file is missing, stale or from another build layout
+	bool load(const std::string& filename, uint64_t sceneKey, PolygonData& objects);
+
+	// writes the derived geometry and accelerator as flat, 16 byte aligned arrays behind a versioned header
+	void save(const std::string& filename, uint64_t sceneKey, PolygonData& objects);
+}
@@ -0,0 +1,75 @@
+#include "TaskGraph.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+#include <memory>
+
+void TaskGraph::addDependency(int stage, int dependency) {
+	std::vector<int>& dependents = stages[dependency].dependents;
+	if (std::find(dependents.begin(), dependents.end(), stage) != dependents.end()) return;
+	dependents.push_back(stage);
+	stages[stage].dependencyCount++;
+}
+
+void TaskGraph::add(const std::string& name, const std::vector<std::string>& reads, const std::vector<std::string>& writes, std::function<void()> work) {
+	int stage = stages.size();
+	stages.push_back({ name, std::move(work), {}, 0, 0 });
+	for (const std::string& resource : reads) {
+		auto writer = lastWriter.find(resource);
+		if (writer != lastWriter.end()) addDependency(stage, writer->second);
+	}
+	for (const std::string& resource : writes) {
+		auto writer = lastWriter.find(resource);
+		if (writer != lastWriter.end()) addDependency(stage, writer->second);
+		for (int reader : readersSinceWrite[resource]) {
+			if (reader != stage) addDependency(stage, reader);
+		}
+	}
+	for (const std::string& resource : reads) readersSinceWrite[resource].push_back(stage);
+	for (const std::string& resource : writes) {
+		lastWriter[resource] = stage;
+		readersSinceWrite[resource].clear();
+	}
+}
+
+void TaskGraph::run() {
+	int stageCount = stages.size();
+	if (stageCount == 0) return;
+	std::unique_ptr<std::atomic<int>[]> waiting(new std::atomic<int>[stageCount]);
+	for (int stage = 0; stage < stageCount; stage++) waiting[stage] = stages[stage].dependencyCount;
+	std::mutex mutex;
+	std::condition_variable allFinished;
+	int finished = 0;
+
+	// each stage queues the dependents it was the last thing holding up, as a continuation
+	std::function<void(int)> launch = [&](int stage) {
+		threadPool.submit([&, stage] {
+			auto start = std::chrono::steady_clock::now();
+			stages[stage].work();
+			stages[stage].milliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+			for (int dependent : stages[stage].dependents) {
+				if (--waiting[dependent] == 0) launch(dependent);
+			}
+			// counted under the lock, so run cannot return and destroy this state mid-notify
+			std::lock_guard<std::mutex> lock(mutex);
+			if (++finished == stageCount) allFinished.notify_all();
+		});
+	};
+	for (int stage = 0; stage < stageCount; stage++) {
+		if (stages[stage].dependencyCount == 0) launch(stage);
+	}
+	std::unique_lock<std::mutex> lock(mutex);
+	allFinished.wait(lock, [&] { return finished == stageCount; });
+}
+
+void TaskGraph::clear() {
+	stages.clear();
+	lastWriter.clear();
+	readersSinceWrite.clear();
+}
+
+std::vector<std::pair<std::string, float>> TaskGraph::getTimings() const {
+	std::vector<std::pair<std::string, float>> timings;
+	for (const Stage& stage : stages) timings.push_back({ stage.name, stage.milliseconds });
+	return timings;
+}
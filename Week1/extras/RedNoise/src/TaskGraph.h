@@ -0,0 +1,39 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <functional>
+#include <utility>
+
+// the stages of a frame and what they read and write. a stage runs on the thread pool as soon as every earlier
+// stage it conflicts with has finished, so stages that share nothing overlap
+class TaskGraph {
+private:
+	struct Stage {
+		std::string name;
+		std::function<void()> work;
+		std::vector<int> dependents; // stages waiting on this one
+		int dependencyCount;
+		float milliseconds; // how long it took in the last run
+	};
+
+	std::vector<Stage> stages;
+	std::map<std::string, int> lastWriter;
+	std::map<std::string, std::vector<int>> readersSinceWrite;
+
+	void addDependency(int stage, int dependency);
+
+public:
+	// declares a stage. it runs after the last earlier stage that writes anything it reads or writes, and after
+	// the earlier stages that read what it writes
+	void add(const std::string& name, const std::vector<std::string>& reads, const std::vector<std::string>& writes, std::function<void()> work);
+
+	// runs every stage and returns once they have all finished. the caller only waits, so it must not be a pool worker
+	void run();
+
+	// forgets the stages, so the next frame can declare its own
+	void clear();
+
+	// name and milliseconds of every stage in the last run, in the order they were added
+	std::vector<std::pair<std::string, float>> getTimings() const;
+};
@@ -0,0 +1,145 @@
+#include "ThreadPool.h"
+#include <algorithm>
+
+ThreadPool threadPool(std::thread::hardware_concurrency());
+
+namespace {
+	// indices of one parallelFor call, claimed one at a time by the caller and the helper tasks it queued. shared
+	// with the helpers, since those that only start after every index was claimed outlive the call
+	struct Batch {
+		int count;
+		std::atomic<int> next;
+		std::atomic<int> remaining;
+		std::mutex mutex;
+		std::condition_variable finished;
+	};
+
+	// queue of the pool worker running on this thread, -1 on every other thread
+	thread_local int currentQueue = -1;
+
+	// runs indices of batch until none are left to claim
+	void drain(Batch& batch, const std::function<void(int)>& task) {
+		for (int i = batch.next++; i < batch.count; i = batch.next++) {
+			task(i);
+			// counted down under the lock, so the caller cannot return and destroy task mid-notify
+			std::lock_guard<std::mutex> lock(batch.mutex);
+			if (--batch.remaining == 0) batch.finished.notify_all();
+		}
+	}
+}
+
+ThreadPool::ThreadPool(int workerCount) : queuedTasks(0), nextQueue(0), stopping(false) {
+	start(workerCount);
+}
+
+ThreadPool::~ThreadPool() {
+	stop();
+}
+
+void ThreadPool::start(int workerCount) {
+	// hardware_concurrency may report 0 when it cannot tell
+	if (workerCount < 1) workerCount = 1;
+	stopping = false;
+	for (int i = 0; i < workerCount; i++) queues.emplace_back(new WorkerQueue());
+	for (int i = 0; i < workerCount; i++) workers.emplace_back(&ThreadPool::workerLoop, this, i);
+}
+
+void ThreadPool::stop() {
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		stopping = true;
+	}
+	sleepCondition.notify_all();
+	for (auto& worker : workers) worker.join();
+	workers.clear();
+	queues.clear();
+}
+
+int ThreadPool::getWorkerCount() const {
+	return workers.size();
+}
+
+void ThreadPool::resize(int workerCount) {
+	if (workerCount < 1) workerCount = 1;
+	if (workerCount == getWorkerCount()) return;
+	stop();
+	start(workerCount);
+}
+
+void ThreadPool::push(std::function<void()> task) {
+	// workers keep what they queue to themselves until someone steals it, other threads spread it out
+	int queueIndex = currentQueue >= 0 && currentQueue < int(queues.size()) ? currentQueue : int(nextQueue++ % queues.size());
+	WorkerQueue& queue = *queues[queueIndex];
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.tasks.push_back(std::move(task));
+	}
+	{
+		// counted under the sleep lock so that a worker about to sleep cannot miss it
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		queuedTasks++;
+	}
+	sleepCondition.notify_one();
+}
+
+bool ThreadPool::pop(int queueIndex, std::function<void()>& task) {
+	{
+		WorkerQueue& own = *queues[queueIndex];
+		std::lock_guard<std::mutex> lock(own.mutex);
+		if (!own.tasks.empty()) {
+			task = std::move(own.tasks.back());
+			own.tasks.pop_back();
+			queuedTasks--;
+			return true;
+		}
+	}
+	int queueCount = queues.size();
+	for (int offset = 1; offset < queueCount; offset++) {
+		int victim = (queueIndex + offset) % queueCount;
+		WorkerQueue& other = *queues[victim];
+		std::lock_guard<std::mutex> lock(other.mutex);
+		if (other.tasks.empty()) continue;
+		task = std::move(other.tasks.front());
+		other.tasks.pop_front();
+		queuedTasks--;
+		return true;
+	}
+	return false;
+}
+
+void ThreadPool::workerLoop(int queueIndex) {
+	currentQueue = queueIndex;
+	while (true) {
+		std::function<void()> task;
+		if (pop(queueIndex, task)) {
+			task();
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		sleepCondition.wait(lock, [this] { return stopping || queuedTasks > 0; });
+		if (stopping && queuedTasks == 0) return;
+	}
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+	push(std::move(task));
+}
+
+void ThreadPool::parallelFor(int count, const std::function<void(int)>& task) {
+	if (count <= 0) return;
+	std::shared_ptr<Batch> batch = std::make_shared<Batch>();
+	batch->count = count;
+	batch->next = 0;
+	batch->remaining = count;
+	// one helper per worker at most, the caller claims indices too. helpers that start late find nothing left and
+	// never touch task, which is only guaranteed to live until this returns
+	int helperCount = std::min(count, getWorkerCount());
+	for (int helper = 0; helper < helperCount; helper++) {
+		push([batch, &task] { drain(*batch, task); });
+	}
+
+	// the caller only ever helps with its own indices, then waits for those the helpers are still running
+	drain(*batch, task);
+	std::unique_lock<std::mutex> lock(batch->mutex);
+	batch->finished.wait(lock, [&batch] { return batch->remaining == 0; });
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <functional>
+
+// process-lifetime workers, each with its own deque of tasks. tasks a worker queues go on its own deque, those
+// of other threads are spread round robin. workers take from the back of their own deque and steal from the
+// front of the others' when it runs dry
+class ThreadPool {
+private:
+	struct WorkerQueue {
+		std::mutex mutex;
+		std::deque<std::function<void()>> tasks;
+	};
+
+	std::vector<std::unique_ptr<WorkerQueue>> queues;
+	std::vector<std::thread> workers;
+	std::mutex sleepMutex;
+	std::condition_variable sleepCondition;
+	std::atomic<int> queuedTasks;
+	std::atomic<unsigned> nextQueue;
+	bool stopping;
+
+	void push(std::function<void()> task);
+	// own deque first, then steals from the others
+	bool pop(int queueIndex, std::function<void()>& task);
+	void workerLoop(int queueIndex);
+	void start(int workerCount);
+	// lets the workers drain the queues, then joins them
+	void stop();
+
+public:
+	explicit ThreadPool(int workerCount);
+	~ThreadPool();
+
+	int getWorkerCount() const;
+
+	// replaces the workers with workerCount new ones. must not be called while a parallelFor is running
+	void resize(int workerCount);
+
+	// runs task(i) for every i in [0, count) and returns once they have all finished. the calling thread claims
+	// indices alongside the workers, but never runs unrelated tasks, so passes may be nested inside pool tasks
+	void parallelFor(int count, const std::function<void(int)>& task);
+
+	// queues task and returns straight away, the caller has to keep whatever it refers to alive until it has run
+	void submit(std::function<void()> task);
+};
+
+// shared by tracing, filtering and Gouraud preprocessing, sized to the hardware's thread count until resized
+extern ThreadPool threadPool;
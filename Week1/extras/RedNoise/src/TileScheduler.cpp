@@ -0,0 +1,65 @@
+#include "TileScheduler.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <numeric>
+#include <chrono>
+
+namespace {
+	// interleaves the bits of x and y, so that tiles close in the order are close on screen
+	uint32_t mortonCode(uint32_t x, uint32_t y) {
+		uint32_t code = 0;
+		for (int bit = 0; bit < 16; bit++) {
+			code |= ((x >> bit) & 1) << (2 * bit);
+			code |= ((y >> bit) & 1) << (2 * bit + 1);
+		}
+		return code;
+	}
+}
+
+TileScheduler::TileScheduler(int width, int height) : width(0), height(0), orderByCost(false) {
+	resize(width, height);
+}
+
+void TileScheduler::resize(int newWidth, int newHeight) {
+	if (newWidth == width && newHeight == height) return;
+	width = newWidth;
+	height = newHeight;
+	tileOrigins.clear();
+	for (int y = 0; y < height; y += TILE_SIZE) {
+		for (int x = 0; x < width; x += TILE_SIZE) tileOrigins.push_back({ x, y });
+	}
+	std::sort(tileOrigins.begin(), tileOrigins.end(), [](glm::ivec2 first, glm::ivec2 second) {
+		return mortonCode(first.x / TILE_SIZE, first.y / TILE_SIZE) < mortonCode(second.x / TILE_SIZE, second.y / TILE_SIZE);
+	});
+	tileCosts.assign(tileOrigins.size(), 0);
+}
+
+int TileScheduler::getTileCount() const {
+	return tileOrigins.size();
+}
+
+bool TileScheduler::run(const std::function<void(glm::ivec2, glm::ivec2)>& renderTile, Cancellation cancellation) {
+	std::vector<int> order(tileOrigins.size());
+	std::iota(order.begin(), order.end(), 0);
+	if (orderByCost) {
+		// stable, so that tiles of equal cost keep their Morton order
+		std::stable_sort(order.begin(), order.end(), [this](int first, int second) {
+			return tileCosts[first] > tileCosts[second];
+		});
+	}
+
+	// each worker keeps taking the next tile in order until none are left
+	std::atomic<int> nextTile(0);
+	threadPool.parallelFor(threadPool.getWorkerCount(), [&](int worker) {
+		for (int slot = nextTile++; slot < int(order.size()); slot = nextTile++) {
+			if (cancellation.isStale()) return;
+			int tile = order[slot];
+			glm::ivec2 tileMin = tileOrigins[tile];
+			glm::ivec2 tileMax = glm::min(tileMin + TILE_SIZE, glm::ivec2(width, height));
+			auto start = std::chrono::steady_clock::now();
+			renderTile(tileMin, tileMax);
+			tileCosts[tile] = std::chrono::duration<float, std::micro>(std::chrono::steady_clock::now() - start).count();
+		}
+	});
+	return !cancellation.isStale();
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <vector>
+#include <functional>
+#include <atomic>
+
+const int TILE_SIZE = 16;
+
+// lets the tiles of a frame in flight notice that input has superseded it
+struct Cancellation {
+	const std::atomic<unsigned>* epoch; // bumped whenever input changes the view, null when the frame cannot be cancelled
+	unsigned frameEpoch; // value of epoch the frame was started for
+
+	bool isStale() const {
+		return epoch != nullptr && epoch->load(std::memory_order_relaxed) != frameEpoch;
+	}
+};
+
+// splits a frame into square tiles in Morton order and hands them out to the thread pool one at a time,
+// so that an expensive region only holds up the worker that took it
+class TileScheduler {
+private:
+	int width;
+	int height;
+	std::vector<glm::ivec2> tileOrigins; // Morton order
+	std::vector<float> tileCosts; // microseconds each tile took last frame, parallel to tileOrigins
+
+public:
+	bool orderByCost; // start the most expensive tiles of the previous frame first
+
+	TileScheduler(int width, int height);
+
+	// rebuilds the tiles when the frame size changes, forgetting the measured costs
+	void resize(int width, int height);
+
+	int getTileCount() const;
+
+	// calls renderTile(tileMin, tileMax) for every tile across the thread pool and records how long each took.
+	// workers check cancellation before every tile and stop once it is stale, returns false when that happened
+	bool run(const std::function<void(glm::ivec2, glm::ivec2)>& renderTile, Cancellation cancellation = { nullptr, 0 });
+};
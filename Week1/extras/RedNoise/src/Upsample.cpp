@@ -0,0 +1,74 @@
+#include "Upsample.h"
+#include "ThreadPool.h"
+#include <limits>
+
+namespace {
+	// how sharply a sample is rejected as its depth moves away from the reference, relative to the reference depth
+	const float DEPTH_TOLERANCE = 0.05f;
+	const float NORMAL_EXPONENT = 8;
+
+	float edgeWeight(float depth, glm::vec3 normal, float referenceDepth, glm::vec3 referenceNormal) {
+		bool escaped = depth == std::numeric_limits<float>::max();
+		bool referenceEscaped = referenceDepth == std::numeric_limits<float>::max();
+		// the background only blends with background
+		if (escaped || referenceEscaped) return escaped == referenceEscaped ? 1.0f : 0.0f;
+		float depthWeight = glm::exp(-glm::abs(depth - referenceDepth) / (DEPTH_TOLERANCE * referenceDepth));
+		float normalWeight = glm::pow(glm::max(glm::dot(normal, referenceNormal), 0.0f), NORMAL_EXPONENT);
+		return depthWeight * normalWeight;
+	}
+}
+
+void Upsample::edgeAware(const RenderTarget& source, std::vector<std::vector<uint32_t>>& colorBuffer, GeometryBuffer& geometry,
+	const RenderTarget& destination, std::vector<std::vector<uint32_t>>& output) {
+	destination.fitBuffer(output, 0u);
+	if (source.width == destination.width && source.height == destination.height) {
+		output = colorBuffer;
+		return;
+	}
+	float ratioX = float(source.width) / destination.width;
+	float ratioY = float(source.height) / destination.height;
+	int bandCount = (destination.height + BAND_HEIGHT - 1) / BAND_HEIGHT;
+	threadPool.parallelFor(bandCount, [&](int band) {
+		int endY = glm::min((band + 1) * BAND_HEIGHT, destination.height);
+		for (int y = band * BAND_HEIGHT; y < endY; y++) {
+			float sourceY = y * ratioY;
+			int top = glm::min(int(sourceY), source.height - 1);
+			int bottom = glm::min(top + 1, source.height - 1);
+			float fractionY = sourceY - top;
+			for (int x = 0; x < destination.width; x++) {
+				float sourceX = x * ratioX;
+				int left = glm::min(int(sourceX), source.width - 1);
+				int right = glm::min(left + 1, source.width - 1);
+				float fractionX = sourceX - left;
+
+				int nearestX = fractionX < 0.5f ? left : right;
+				int nearestY = fractionY < 0.5f ? top : bottom;
+				float referenceDepth = geometry.hits[nearestY][nearestX].distance;
+				glm::vec3 referenceNormal = geometry.hits[nearestY][nearestX].faceNormal;
+
+				glm::ivec2 taps[4] = { { left, top }, { right, top }, { left, bottom }, { right, bottom } };
+				float bilinear[4] = {
+					(1 - fractionX) * (1 - fractionY), fractionX * (1 - fractionY),
+					(1 - fractionX) * fractionY, fractionX * fractionY
+				};
+				glm::vec3 colour(0);
+				float sumOfWeights = 0;
+				for (int tap = 0; tap < 4; tap++) {
+					int tapX = taps[tap].x;
+					int tapY = taps[tap].y;
+					float weight = bilinear[tap] * edgeWeight(geometry.hits[tapY][tapX].distance, geometry.hits[tapY][tapX].faceNormal, referenceDepth, referenceNormal);
+					uint32_t packed = colorBuffer[tapY][tapX];
+					colour += weight * glm::vec3((packed >> 16) & 0xff, (packed >> 8) & 0xff, packed & 0xff);
+					sumOfWeights += weight;
+				}
+				// the nearest sample always matches itself, but its bilinear weight can be close to 0
+				if (sumOfWeights < 1e-4f) {
+					output[y][x] = colorBuffer[nearestY][nearestX];
+					continue;
+				}
+				glm::ivec3 channels = glm::ivec3(colour / sumOfWeights + 0.5f);
+				output[y][x] = (255 << 24) + (channels.r << 16) + (channels.g << 8) + channels.b;
+			}
+		}
+	});
+}
@@ -0,0 +1,12 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include "RenderTarget.h"
+#include "Raytrace.h"
+
+namespace Upsample {
+	// scales a frame traced at source up to destination. each pixel blends the four nearest samples, weighted
+	// down where their depth or normal differs from the nearest one, so that colours do not bleed across edges
+	void edgeAware(const RenderTarget& source, std::vector<std::vector<uint32_t>>& colorBuffer, GeometryBuffer& geometry,
+		const RenderTarget& destination, std::vector<std::vector<uint32_t>>& output);
+}
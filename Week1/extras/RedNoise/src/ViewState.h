@@ -0,0 +1,15 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <SceneAccelerator.h>
+#include "Camera.h"
+#include "Lighting.h"
+
+// everything input can change that a frame in flight reads. input edits its own copy as events arrive,
+// and the main loop publishes it whole between frames
+struct ViewState {
+	Camera camera;
+	glm::vec3 lightPosition;
+	Lighting lighting;
+	BVHLayout layout;
+	bool orderByCost; // start the most expensive tiles of the previous frame first
+};
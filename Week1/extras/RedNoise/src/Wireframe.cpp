@@ -10,9 +10,9 @@ void Wireframe::drawLine(DrawingWindow& window, CanvasPoint start, CanvasPoint e
 	uint32_t pixelColor = (255 << 24) + (int(color.red) << 16) + (int(color.green) << 8) + int(color.blue);
 	for (int i = 0; i < stepCount; i++) {
 		int x = std::round(start.x + xStepSize * i);
-		if (x >= WIDTH || x < 0) continue;
+		if (x >= int(window.width) || x < 0) continue;
 		int y = std::round(start.y + yStepSize * i);
-		if (y >= HEIGHT || y < 0) continue;
+		if (y >= int(window.height) || y < 0) continue;
 		window.setPixelColour(x, y, pixelColor);
 	}
 }
@@ -25,36 +25,34 @@ void Wireframe::drawStrokedTriangle(DrawingWindow& window, CanvasTriangle triang
 
 void Wireframe::drawCloudPoints(DrawingWindow& window, Camera& camera, std::vector<CanvasPoint> loadedVertices) {
 	for (const auto& vertex: loadedVertices) {
-		if (vertex.x < 0 || vertex.x >= WIDTH || vertex.y < 0 || vertex.y >= HEIGHT) continue;
+		if (vertex.x < 0 || vertex.x >= window.width || vertex.y < 0 || vertex.y >= window.height) continue;
 		uint32_t color = (255 << 24) + (255 << 16) + (255 << 8) + 255;
 		window.setPixelColour(vertex.x, vertex.y, color);
 	}
 }
 
-CanvasPoint Wireframe::canvasIntersection(Camera& camera, glm::vec3 vertexPosition, float focalLength, const glm::mat3& viewMatrix) {
+CanvasPoint Wireframe::canvasIntersection(Camera& camera, glm::vec3 vertexPosition, const RenderTarget& target, const glm::mat3& viewMatrix) {
 
 	// find the displacement relative to the camera, 
 	// then get the position vector in terms of the camera's POV
 	const glm::vec3 displacement = camera.cameraPosition - vertexPosition;
 	const glm::vec3 adjustedVector = displacement * viewMatrix;
 
-	int scaleFactor = 180;
+	float u = target.focalLength * (adjustedVector.x / adjustedVector.z) * target.scale + float(target.width) / 2;
 
-	float u = focalLength * (adjustedVector.x / adjustedVector.z) * scaleFactor + float(WIDTH) / 2;
-
-	float v = focalLength * (adjustedVector.y / adjustedVector.z) * scaleFactor + float(HEIGHT) / 2;
+	float v = target.focalLength * (adjustedVector.y / adjustedVector.z) * target.scale + float(target.height) / 2;
 	// fixes horizontal flip
-	u = WIDTH - u;
+	u = target.width - u;
 	return CanvasPoint(u, v, -adjustedVector.z);
 }
 
-void Wireframe::drawWireframe(DrawingWindow& window, Camera& camera, PolygonData& objects) {
+void Wireframe::drawWireframe(DrawingWindow& window, Camera& camera, PolygonData& objects, const RenderTarget& target) {
 	//for (const ModelTriangle& object : objects) {
 	for (int i = 0; i < objects.loadedTriangles.size(); i++) {
 
-		CanvasPoint first = canvasIntersection(camera, objects.getTriangleVertexPosition(i, 0), 2.0, glm::mat3(1.0));
-		CanvasPoint second = canvasIntersection(camera, objects.getTriangleVertexPosition(i, 1), 2.0, glm::mat3(1.0));
-		CanvasPoint third = canvasIntersection(camera, objects.getTriangleVertexPosition(i, 2), 2.0, glm::mat3(1.0));
+		CanvasPoint first = canvasIntersection(camera, objects.getTriangleVertexPosition(i, 0), target, glm::mat3(1.0));
+		CanvasPoint second = canvasIntersection(camera, objects.getTriangleVertexPosition(i, 1), target, glm::mat3(1.0));
+		CanvasPoint third = canvasIntersection(camera, objects.getTriangleVertexPosition(i, 2), target, glm::mat3(1.0));
 
 		CanvasTriangle flattened(first, second, third);
 		drawStrokedTriangle(window, flattened, Colour(255, 255, 255));
@@ -7,6 +7,7 @@
 #include <unordered_map>
 #include <ModelTriangle.h>
 #include <PolygonData.h>
+#include "RenderTarget.h"
 
 namespace Wireframe {
 	// draws a line between 2 CanvasPoints
@@ -18,10 +19,10 @@ namespace Wireframe {
 	// used for pointcloud representation
 	void drawCloudPoints(DrawingWindow& window, Camera& camera, std::vector<CanvasPoint> loadedVertices);
 
-	// computes the canvas intersection of a triangle point wrt camera position
-	CanvasPoint canvasIntersection(Camera& camera, glm::vec3 vertexPosition, float focalLength, const glm::mat3& viewMatrix = glm::mat3(1.0));
+	// computes the canvas intersection of a triangle point wrt camera position, projected onto target
+	CanvasPoint canvasIntersection(Camera& camera, glm::vec3 vertexPosition, const RenderTarget& target, const glm::mat3& viewMatrix = glm::mat3(1.0));
 
 	// draws wireframe render
-	void drawWireframe(DrawingWindow& window, Camera& camera, PolygonData& objects);
+	void drawWireframe(DrawingWindow& window, Camera& camera, PolygonData& objects, const RenderTarget& target);
 
 }
\ No newline at end of file
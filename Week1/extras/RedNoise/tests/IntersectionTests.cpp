@@ -0,0 +1,304 @@
+#include <PolygonData.h>
+#include <TriangleKernels.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+// every SIMD kernel and every tree traversal is compared with a linear scan of the scalar kernel over all triangles,
+// which is what the acceleration structures have to reproduce, ties going to the higher triangle index included
+namespace {
+	const int RAY_COUNT = 20000;
+	// relative to the distance, as the deep scene spans 1e12
+	const float DISTANCE_TOLERANCE = 1e-3f;
+	int failures = 0;
+
+	void check(bool condition, const std::string& what) {
+		if (condition) return;
+		failures++;
+		if (failures <= 20) std::printf("FAILED: %s\n", what.c_str());
+	}
+
+	void addTriangle(PolygonData& objects, glm::vec3 v0, glm::vec3 v1, glm::vec3 v2, const std::string& objectName) {
+		int first = objects.loadedVertices.size();
+		for (glm::vec3 position : { v0, v1, v2 }) {
+			objects.loadedVertices.emplace_back();
+			objects.loadedVertices.back().position = position;
+		}
+		int triangleIndex = objects.loadedTriangles.size();
+		objects.loadedTriangles.emplace_back(first, first + 1, first + 2, Colour(255, 255, 255));
+		objects.loadedTriangles.back().objectName = objectName;
+		for (int corner = 0; corner < 3; corner++) objects.vertexToTriangles[first + corner].insert(triangleIndex);
+	}
+
+	// a few objects of small random triangles scattered through overlapping boxes
+	PolygonData makeScene(std::mt19937& random) {
+		std::uniform_real_distribution<float> unit(-1, 1);
+		PolygonData objects;
+		const char* names[] = { "first", "second", "third", "fourth", "fifth" };
+		for (int object = 0; object < 5; object++) {
+			glm::vec3 centre(object - 2.0f, unit(random), unit(random));
+			for (int triangle = 0; triangle < 300; triangle++) {
+				glm::vec3 corner = centre + 1.5f * glm::vec3(unit(random), unit(random), unit(random));
+				addTriangle(objects, corner, corner + 0.3f * glm::vec3(unit(random), unit(random), unit(random)),
+					corner + 0.3f * glm::vec3(unit(random), unit(random), unit(random)), names[object]);
+			}
+		}
+		objects.computeTriangleGeometry();
+		objects.accelerator.build(objects);
+		return objects;
+	}
+
+	// tilted triangles doubling in size along x, which binned SAH splits peel off a few at a time into a lopsided tree.
+	// any larger and the products inside the ray-triangle test leave the float range
+	PolygonData makeDeepScene() {
+		PolygonData objects;
+		for (int triangle = 0; triangle < 40; triangle++) {
+			float size = std::pow(2.0f, float(triangle));
+			glm::vec3 centre(size, 0, -5 - 0.01f * triangle);
+			addTriangle(objects, centre + glm::vec3(-0.4f * size, -0.4f * size, 0), centre + glm::vec3(0.4f * size, -0.4f * size, 0),
+				centre + glm::vec3(0, 0.4f * size, 0.4f * size), "deep");
+		}
+		objects.computeTriangleGeometry();
+		objects.accelerator.build(objects);
+		return objects;
+	}
+
+	// a few small triangles round the origin next to ones out towards the ends of the float range, which need the
+	// widest quantized steps there are
+	PolygonData makeExtremeScene() {
+		PolygonData objects;
+		float far = 0.4f * std::numeric_limits<float>::max();
+		for (int triangle = 0; triangle < 8; triangle++) {
+			glm::vec3 corner(triangle - 4.0f, 0, -5);
+			addTriangle(objects, corner, corner + glm::vec3(0.8f, 0, 0), corner + glm::vec3(0, 0.8f, 0), "extreme");
+		}
+		addTriangle(objects, glm::vec3(-far, 0, 0), glm::vec3(-far, 1, 0), glm::vec3(-far, 0, 1), "extreme");
+		addTriangle(objects, glm::vec3(far, 0, 0), glm::vec3(far, 1, 0), glm::vec3(far, 0, 1), "extreme");
+		objects.computeTriangleGeometry();
+		objects.accelerator.build(objects);
+		return objects;
+	}
+
+	std::vector<TriangleRecord> linearRecords(PolygonData& objects, const std::string& hiddenObject = "") {
+		std::vector<TriangleRecord> records;
+		for (int triangleIndex = 0; triangleIndex < int(objects.loadedTriangles.size()); triangleIndex++) {
+			if (objects.loadedTriangles[triangleIndex].objectName == hiddenObject) continue;
+			TriangleRecord record = {};
+			record.v0 = objects.getTriangleVertexPosition(triangleIndex, 0);
+			record.triangleIndex = triangleIndex;
+			record.e0 = objects.getTriangleVertexPosition(triangleIndex, 1) - record.v0;
+			record.e1 = objects.getTriangleVertexPosition(triangleIndex, 2) - record.v0;
+			records.push_back(record);
+		}
+		return records;
+	}
+
+	BVHHit linearHit(const std::vector<TriangleRecord>& records, glm::vec3 origin, glm::vec3 direction, int excludeID, float maxDistance) {
+		BVHHit hit;
+		hit.triangleIndex = -1;
+		float closest = maxDistance;
+		intersectTriangleRecords(records.data(), records.size(), origin, direction, excludeID, closest, hit);
+		return hit;
+	}
+
+	// the same triangle, or another one at the same distance where rounding decided between them. the distance
+	// to the same triangle is not compared, grazing rays magnify the rounding differences between the kernels
+	bool sameHit(const BVHHit& hit, const BVHHit& expected) {
+		if (hit.triangleIndex == expected.triangleIndex) return true;
+		if (hit.triangleIndex == -1 || expected.triangleIndex == -1) return false;
+		return std::abs(hit.distance - expected.distance) <= DISTANCE_TOLERANCE * std::max(1.0f, expected.distance);
+	}
+
+	glm::vec3 randomDirection(std::mt19937& random) {
+		std::normal_distribution<float> normal(0, 1);
+		return glm::normalize(glm::vec3(normal(random), normal(random), normal(random)));
+	}
+
+	void testKernels(PolygonData& objects, std::mt19937& random) {
+		std::vector<TriangleRecord> records = linearRecords(objects);
+		std::uniform_real_distribution<float> unit(-1, 1);
+		std::uniform_int_distribution<int> start(0, int(records.size()) - PACKET_WIDTH);
+		for (int ray = 0; ray < RAY_COUNT; ray++) {
+			glm::vec3 origin = 4.0f * glm::vec3(unit(random), unit(random), unit(random));
+			glm::vec3 direction = randomDirection(random);
+			int first = start(random);
+			// a partly filled packet as well, whose empty lanes must never hit
+			int count = ray % 2 == 0 ? PACKET_WIDTH : 1 + ray % PACKET_WIDTH;
+			int excludeID = ray % 3 == 0 ? records[first].triangleIndex : -1;
+			TrianglePacket packet;
+			fillTrianglePacket(packet, &records[first], count);
+
+			BVHHit expected;
+			expected.triangleIndex = -1;
+			float expectedClosest = std::numeric_limits<float>::max();
+			intersectTriangleRecords(&records[first], count, origin, direction, excludeID, expectedClosest, expected);
+			BVHHit hit;
+			hit.triangleIndex = -1;
+			float closest = std::numeric_limits<float>::max();
+			intersectTrianglePacket(packet, origin, direction, excludeID, closest, hit);
+			check(sameHit(hit, expected), "packet kernel closest hit, ray " + std::to_string(ray));
+
+			float maxDistance = expected.triangleIndex == -1 ? 10.0f : expected.distance * (ray % 2 == 0 ? 0.99f : 1.01f);
+			check(occludedTrianglePacket(packet, origin, direction, excludeID, maxDistance) ==
+				occludedTriangleRecords(&records[first], count, origin, direction, excludeID, maxDistance),
+				"packet kernel occlusion, ray " + std::to_string(ray));
+		}
+	}
+
+	void testTrees(PolygonData& objects, std::mt19937& random, const std::string& scene) {
+		std::vector<TriangleRecord> records = linearRecords(objects);
+		std::vector<std::vector<TriangleRecord>> instanceRecords(objects.accelerator.instances.size());
+		for (int instance = 0; instance < int(instanceRecords.size()); instance++) {
+			for (const TriangleRecord& record : records) {
+				const std::string& objectName = objects.loadedTriangles[record.triangleIndex].objectName;
+				if (objectName == objects.accelerator.instances[instance].objectName) instanceRecords[instance].push_back(record);
+			}
+		}
+		glm::vec3 sceneMin = objects.sceneBoundingMinMax.first;
+		glm::vec3 sceneMax = objects.sceneBoundingMinMax.second;
+		glm::vec3 padding = 0.5f * (sceneMax - sceneMin);
+		std::uniform_real_distribution<float> along(0, 1);
+		std::uniform_int_distribution<int> target(0, int(records.size()) - 1);
+		for (int ray = 0; ray < RAY_COUNT; ray++) {
+			glm::vec3 origin = sceneMin - padding + (sceneMax - sceneMin + 2.0f * padding) * glm::vec3(along(random), along(random), along(random));
+			glm::vec3 direction = randomDirection(random);
+			if (ray % 2 == 0) {
+				// half of the rays aimed at a triangle from a few times its size away, so that most of them hit something
+				const TriangleRecord& aimedAt = records[target(random)];
+				float size = glm::length(aimedAt.e0) + glm::length(aimedAt.e1);
+				origin = aimedAt.v0 + (aimedAt.e0 + aimedAt.e1) / 3.0f - (1 + 2 * along(random)) * size * direction;
+			}
+			int excludeID = ray % 4 == 0 ? ray % int(records.size()) : -1;
+			BVHHit expected = linearHit(records, origin, direction, excludeID, std::numeric_limits<float>::max());
+			std::string where = scene + ", ray " + std::to_string(ray);
+
+			for (int instanceIndex = 0; instanceIndex < int(instanceRecords.size()); instanceIndex++) {
+				const ObjectInstance& instance = objects.accelerator.instances[instanceIndex];
+				BVHHit instanceExpected = linearHit(instanceRecords[instanceIndex], origin, direction, excludeID, std::numeric_limits<float>::max());
+				BVHHit binary, wide, quantized;
+				binary.triangleIndex = wide.triangleIndex = quantized.triangleIndex = -1;
+				instance.bvh.intersect(origin, direction, binary, excludeID);
+				instance.bvh.intersectWide(origin, direction, wide, excludeID);
+				instance.bvh.intersectQuantized(origin, direction, quantized, excludeID);
+				check(sameHit(binary, instanceExpected), "binary tree closest hit, " + where);
+				check(sameHit(wide, instanceExpected), "wide tree closest hit, " + where);
+				check(sameHit(quantized, instanceExpected), "quantized tree closest hit, " + where);
+			}
+
+			for (BVHLayout layout : { BINARY_LAYOUT, WIDE_LAYOUT, QUANTIZED_LAYOUT }) {
+				objects.accelerator.layout = layout;
+				std::string query = " in layout " + std::to_string(layout) + ", " + where;
+				BVHHit hit;
+				hit.triangleIndex = -1;
+				objects.accelerator.intersect(origin, direction, hit, excludeID);
+				check(sameHit(hit, expected), "scene closest hit" + query);
+				if (expected.triangleIndex == -1) {
+					check(!objects.accelerator.occluded(origin, direction, excludeID, 1e6f), "scene occlusion of a miss" + query);
+					continue;
+				}
+				// just short of and just past the closest hit, away from where rounding could go either way
+				check(!objects.accelerator.occluded(origin, direction, excludeID, expected.distance * 0.99f), "scene occlusion short of the hit" + query);
+				check(objects.accelerator.occluded(origin, direction, excludeID, expected.distance * 1.01f), "scene occlusion past the hit" + query);
+			}
+			objects.accelerator.layout = BINARY_LAYOUT;
+		}
+	}
+
+	void testPackets(PolygonData& objects, std::mt19937& random) {
+		std::vector<TriangleRecord> records = linearRecords(objects);
+		std::uniform_real_distribution<float> unit(-1, 1);
+		for (int tile = 0; tile < RAY_COUNT / MAX_PACKET_RAYS; tile++) {
+			// a camera looking at the scene through an 8x8 tile, and some tiles with rays scattered every way
+			glm::vec3 origin(unit(random), unit(random), 6);
+			bool coherent = tile % 4 != 0;
+			glm::vec3 centre(0.4f * unit(random), 0.4f * unit(random), -1);
+			glm::vec3 directions[MAX_PACKET_RAYS];
+			for (int ray = 0; ray < MAX_PACKET_RAYS; ray++) {
+				glm::vec3 offset(0.01f * (ray % 8), 0.01f * (ray / 8), 0);
+				directions[ray] = coherent ? glm::normalize(centre + offset) : randomDirection(random);
+			}
+			RayPacket packet;
+			initialiseRayPacket(packet, origin, directions, MAX_PACKET_RAYS, std::numeric_limits<float>::max());
+			objects.accelerator.intersectPacket(packet);
+			for (int ray = 0; ray < MAX_PACKET_RAYS; ray++) {
+				BVHHit expected = linearHit(records, origin, directions[ray], -1, std::numeric_limits<float>::max());
+				check(sameHit(packet.hits[ray], expected), "packet traversal, tile " + std::to_string(tile) + " ray " + std::to_string(ray));
+			}
+		}
+	}
+
+	void testHiddenObjects(PolygonData& objects, std::mt19937& random) {
+		objects.accelerator.setHiddenObjects({ "third" });
+		std::vector<TriangleRecord> records = linearRecords(objects, "third");
+		std::uniform_real_distribution<float> unit(-1, 1);
+		for (int ray = 0; ray < RAY_COUNT / 4; ray++) {
+			glm::vec3 origin = 4.0f * glm::vec3(unit(random), unit(random), unit(random));
+			glm::vec3 direction = randomDirection(random);
+			BVHHit expected = linearHit(records, origin, direction, -1, std::numeric_limits<float>::max());
+			BVHHit hit;
+			hit.triangleIndex = -1;
+			objects.accelerator.intersect(origin, direction, hit);
+			check(sameHit(hit, expected), "closest hit with an object hidden, ray " + std::to_string(ray));
+		}
+		objects.accelerator.setHiddenObjects({});
+	}
+
+	int treeDepth(const BoundingVolumeHierarchy& bvh, int nodeIndex) {
+		const BVHNode& node = bvh.nodes[nodeIndex];
+		if (node.triangleCount > 0) return 0;
+		return 1 + std::max(treeDepth(bvh, node.leftFirst), treeDepth(bvh, node.leftFirst + 1));
+	}
+}
+
+int main() {
+	std::printf("triangle kernel: %s\n", getTriangleKernelName(activeTriangleKernel));
+	std::mt19937 random(1);
+	PolygonData objects = makeScene(random);
+	testKernels(objects, random);
+	testTrees(objects, random, "scattered scene");
+	testPackets(objects, random);
+	testHiddenObjects(objects, random);
+
+	// moving an object only recomputes its own triangles and refits its own tree, which have to end up as if the
+	// whole scene had been recomputed, and keep answering like the linear scan
+	objects.translateObject("second", { 0.3f, -0.2f, 0.1f });
+	PolygonData recomputed = objects;
+	recomputed.computeTriangleGeometry();
+	for (int triangleIndex = 0; triangleIndex < int(objects.loadedTriangles.size()); triangleIndex++) {
+		const ModelTriangle& triangle = objects.loadedTriangles[triangleIndex];
+		const ModelTriangle& expected = recomputed.loadedTriangles[triangleIndex];
+		check(triangle.normal == expected.normal && triangle.boundingMinMax == expected.boundingMinMax, "geometry of moved triangle " + std::to_string(triangleIndex));
+	}
+	for (int vertexIndex = 0; vertexIndex < int(objects.loadedVertices.size()); vertexIndex++) {
+		check(objects.loadedVertices[vertexIndex].normal == recomputed.loadedVertices[vertexIndex].normal, "normal of moved vertex " + std::to_string(vertexIndex));
+	}
+	check(objects.sceneBoundingMinMax == recomputed.sceneBoundingMinMax, "scene bounds after a move");
+	testTrees(objects, random, "scattered scene after a refit");
+
+	PolygonData deep = makeDeepScene();
+	int depth = treeDepth(deep.accelerator.instances[0].bvh, 0);
+	check(depth <= 40, "deep scene tree depth " + std::to_string(depth) + " within the builder's cap");
+	testTrees(deep, random, "deep scene");
+
+	// bounds spanning most of the float range still quantize to nodes that rays descend into
+	PolygonData extreme = makeExtremeScene();
+	for (int triangle = 0; triangle < 8; triangle++) {
+		glm::vec3 origin(triangle - 3.7f, 0.2f, 0);
+		BVHHit binary, quantized;
+		binary.triangleIndex = quantized.triangleIndex = -1;
+		extreme.accelerator.instances[0].bvh.intersect(origin, glm::vec3(0, 0, -1), binary, -1);
+		extreme.accelerator.instances[0].bvh.intersectQuantized(origin, glm::vec3(0, 0, -1), quantized, -1);
+		check(binary.triangleIndex == triangle, "binary tree beside extreme bounds, triangle " + std::to_string(triangle));
+		check(quantized.triangleIndex == triangle, "quantized tree beside extreme bounds, triangle " + std::to_string(triangle));
+	}
+
+	if (failures > 0) {
+		std::printf("%d checks failed\n", failures);
+		return 1;
+	}
+	std::printf("all intersection checks passed\n");
+	return 0;
+}
@@ -0,0 +1,134 @@
+#include <IrradianceCache.h>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+// a lookup through the octree finds exactly the records a scan over all of them would, so it interpolates the same
+// visibility, and the records only last as long as the light and the geometry they were sampled for
+namespace {
+	int failures = 0;
+
+	void check(bool condition, const std::string& what) {
+		if (condition) return;
+		failures++;
+		if (failures <= 20) std::printf("FAILED: %s\n", what.c_str());
+	}
+
+	// a few triangles spanning [-1, 1] on every axis, only there to give the cache its bounds
+	PolygonData makeScene() {
+		PolygonData objects;
+		glm::vec3 corners[] = { { -1, -1, -1 }, { 1, -1, -1 }, { -1, 1, -1 }, { 1, 1, 1 }, { -1, 1, 1 }, { 1, -1, 1 } };
+		for (glm::vec3 position : corners) {
+			objects.loadedVertices.emplace_back();
+			objects.loadedVertices.back().position = position;
+		}
+		for (int first = 0; first < 6; first += 3) {
+			int triangleIndex = objects.loadedTriangles.size();
+			objects.loadedTriangles.emplace_back(first, first + 1, first + 2, Colour(255, 255, 255));
+			objects.loadedTriangles.back().objectName = "bounds";
+			for (int corner = 0; corner < 3; corner++) objects.vertexToTriangles[first + corner].insert(triangleIndex);
+		}
+		objects.computeTriangleGeometry();
+		objects.accelerator.build(objects);
+		return objects;
+	}
+
+	glm::vec3 randomDirection(std::mt19937& random) {
+		std::normal_distribution<float> normal(0, 1);
+		return glm::normalize(glm::vec3(normal(random), normal(random), normal(random)));
+	}
+
+	std::vector<IrradianceRecord> randomRecords(std::mt19937& random, int count) {
+		std::uniform_real_distribution<float> unit(-1, 1);
+		std::uniform_real_distribution<float> radius(0.02f, 0.2f);
+		std::vector<IrradianceRecord> records;
+		for (int record = 0; record < count; record++) {
+			records.push_back({ glm::vec3(unit(random), unit(random), unit(random)), randomDirection(random), 0.5f + 0.5f * unit(random),
+				0.3f * glm::vec3(unit(random), unit(random), unit(random)), radius(random) });
+		}
+		return records;
+	}
+
+	void testLookup() {
+		std::mt19937 random(5);
+		PolygonData objects = makeScene();
+		glm::vec3 light(0, 2, 0);
+		std::vector<IrradianceRecord> committed = randomRecords(random, 3000);
+		std::vector<IrradianceRecord> queued = randomRecords(random, 100);
+
+		IrradianceCache cache;
+		cache.validate(objects, light);
+		// committed in several batches, as frames would
+		for (int first = 0; first < int(committed.size()); first += 500) {
+			cache.add(std::vector<IrradianceRecord>(committed.begin() + first, committed.begin() + first + 500));
+			cache.commit();
+		}
+		check(cache.records.size() == committed.size(), "every committed record is kept");
+
+		// an empty cache handed every record as uncommitted scans them all
+		IrradianceCache scan;
+		scan.validate(objects, light);
+		std::vector<IrradianceRecord> everyRecord = committed;
+		everyRecord.insert(everyRecord.end(), queued.begin(), queued.end());
+
+		std::uniform_real_distribution<float> unit(-1, 1);
+		int found = 0;
+		for (int query = 0; query < 20000; query++) {
+			// mostly close to a record, where several of them overlap
+			const IrradianceRecord& near = everyRecord[query % everyRecord.size()];
+			glm::vec3 position = query % 4 == 0 ? glm::vec3(unit(random), unit(random), unit(random)) :
+				near.position + near.radius * 0.4f * glm::vec3(unit(random), unit(random), unit(random));
+			glm::vec3 normal = glm::normalize(near.normal + 0.2f * randomDirection(random));
+			float visibility = -1;
+			float expected = -1;
+			bool hit = cache.lookup(position, normal, queued, visibility);
+			bool expectedHit = scan.lookup(position, normal, everyRecord, expected);
+			std::string where = "query " + std::to_string(query);
+			check(hit == expectedHit, "lookup finds a record exactly when the scan does, " + where);
+			if (hit && expectedHit) {
+				check(std::abs(visibility - expected) < 1e-4f, "lookup interpolates what the scan does, " + where);
+				found++;
+			}
+		}
+		check(found > 2000, "many queries near records find some, " + std::to_string(found));
+	}
+
+	void testValidate() {
+		std::mt19937 random(9);
+		PolygonData objects = makeScene();
+		IrradianceCache cache;
+		cache.validate(objects, glm::vec3(0, 2, 0));
+		cache.add(randomRecords(random, 10));
+		cache.commit();
+		cache.validate(objects, glm::vec3(0, 2, 0));
+		check(cache.records.size() == 10, "records are kept for the same light and geometry");
+		cache.validate(objects, glm::vec3(0, 2, 0.5f));
+		check(cache.records.empty(), "a moved light drops the records");
+
+		cache.add(randomRecords(random, 10));
+		cache.commit();
+		objects.translateObject("bounds", { 0.1f, 0, 0 });
+		cache.validate(objects, glm::vec3(0, 2, 0.5f));
+		check(cache.records.empty(), "moved geometry drops the records");
+
+		// queued records of a frame that was cut short do not survive into the next light either
+		cache.add(randomRecords(random, 10));
+		cache.validate(objects, glm::vec3(0, 2, 0));
+		cache.commit();
+		check(cache.records.empty(), "a moved light drops the queued records");
+	}
+}
+
+int main() {
+	testLookup();
+	testValidate();
+
+	if (failures > 0) {
+		std::printf("%d checks failed\n", failures);
+		return 1;
+	}
+	std::printf("all irradiance cache checks passed\n");
+	return 0;
+}
@@ -0,0 +1,143 @@
+#include <PolygonData.h>
+#include <SceneCache.h>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+// a scene saved to the cache and loaded back into freshly parsed objects has to come back bit for bit, and a cache
+// that does not belong to the scene has to be turned down without touching the objects
+namespace {
+	const char* CACHE_FILE = "SceneCacheTests.cache";
+	const uint64_t SCENE_KEY = 0x5eed;
+	int failures = 0;
+
+	void check(bool condition, const std::string& what) {
+		if (condition) return;
+		failures++;
+		std::printf("FAILED: %s\n", what.c_str());
+	}
+
+	template <typename T>
+	bool sameBytes(const std::vector<T>& a, const std::vector<T>& b) {
+		return a.size() == b.size() && (a.empty() || std::memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0);
+	}
+
+	bool sameTree(const BoundingVolumeHierarchy& a, const BoundingVolumeHierarchy& b) {
+		return a.builtCost == b.builtCost && sameBytes(a.nodes, b.nodes) && sameBytes(a.primitiveIndices, b.primitiveIndices) &&
+			sameBytes(a.records, b.records) && sameBytes(a.packets, b.packets) && sameBytes(a.leafPackets, b.leafPackets) &&
+			sameBytes(a.wideNodes, b.wideNodes) && sameBytes(a.quantizedNodes, b.quantizedNodes) && sameBytes(a.packetFirst, b.packetFirst);
+	}
+
+	// objects as the file reader leaves them, with vertices shared between neighbouring triangles so that the vertex
+	// normals are sums over several faces
+	PolygonData parseScene() {
+		std::mt19937 random(7);
+		std::uniform_real_distribution<float> unit(-1, 1);
+		PolygonData objects;
+		const char* names[] = { "floor", "box", "sphere" };
+		for (int object = 0; object < 3; object++) {
+			int first = objects.loadedVertices.size();
+			for (int vertex = 0; vertex < 60; vertex++) {
+				objects.loadedVertices.emplace_back();
+				objects.loadedVertices.back().position = glm::vec3(object, 0, 0) + glm::vec3(unit(random), unit(random), unit(random));
+			}
+			for (int vertex = first; vertex + 2 < first + 60; vertex++) {
+				int triangleIndex = objects.loadedTriangles.size();
+				objects.loadedTriangles.emplace_back(vertex, vertex + 1, vertex + 2, Colour(255, 255, 255));
+				objects.loadedTriangles.back().objectName = names[object];
+				for (int corner = 0; corner < 3; corner++) objects.vertexToTriangles[vertex + corner].insert(triangleIndex);
+			}
+		}
+		return objects;
+	}
+
+	void testRoundTrip() {
+		PolygonData built = parseScene();
+		built.computeTriangleGeometry();
+		built.accelerator.build(built);
+		SceneCache::save(CACHE_FILE, SCENE_KEY, built);
+
+		PolygonData loaded = parseScene();
+		unsigned versionBefore = loaded.accelerator.version;
+		check(SceneCache::load(CACHE_FILE, SCENE_KEY, loaded), "loading the cache just saved");
+		check(loaded.accelerator.version != versionBefore, "loading moves the accelerator version");
+
+		for (int triangleIndex = 0; triangleIndex < int(built.loadedTriangles.size()); triangleIndex++) {
+			const ModelTriangle& expected = built.loadedTriangles[triangleIndex];
+			const ModelTriangle& triangle = loaded.loadedTriangles[triangleIndex];
+			check(triangle.normal == expected.normal && triangle.boundingMinMax == expected.boundingMinMax,
+				"geometry of triangle " + std::to_string(triangleIndex));
+		}
+		for (int vertexIndex = 0; vertexIndex < int(built.loadedVertices.size()); vertexIndex++) {
+			check(loaded.loadedVertices[vertexIndex].normal == built.loadedVertices[vertexIndex].normal, "normal of vertex " + std::to_string(vertexIndex));
+		}
+		check(loaded.sceneBoundingMinMax == built.sceneBoundingMinMax, "scene bounds");
+
+		check(loaded.accelerator.instances.size() == built.accelerator.instances.size(), "instance count");
+		for (int instance = 0; instance < int(built.accelerator.instances.size()) && instance < int(loaded.accelerator.instances.size()); instance++) {
+			const ObjectInstance& expected = built.accelerator.instances[instance];
+			const ObjectInstance& loadedInstance = loaded.accelerator.instances[instance];
+			check(loadedInstance.objectName == expected.objectName && loadedInstance.visible, "name and mask of instance " + std::to_string(instance));
+			check(sameTree(loadedInstance.bvh, expected.bvh), "tree of instance " + std::to_string(instance));
+		}
+		check(sameTree(loaded.accelerator.topLevel, built.accelerator.topLevel), "top level tree");
+
+		// and the loaded accelerator answers queries as the built one does
+		std::mt19937 random(3);
+		std::normal_distribution<float> normal(0, 1);
+		for (int ray = 0; ray < 1000; ray++) {
+			glm::vec3 origin = 3.0f * glm::vec3(normal(random), normal(random), normal(random));
+			glm::vec3 direction = glm::normalize(glm::vec3(normal(random), normal(random), normal(random)));
+			BVHHit expected, hit;
+			expected.triangleIndex = hit.triangleIndex = -1;
+			built.accelerator.intersect(origin, direction, expected);
+			loaded.accelerator.intersect(origin, direction, hit);
+			check(hit.triangleIndex == expected.triangleIndex && (hit.triangleIndex == -1 || hit.distance == expected.distance),
+				"closest hit through the loaded accelerator, ray " + std::to_string(ray));
+		}
+	}
+
+	void testRejected() {
+		PolygonData built = parseScene();
+		built.computeTriangleGeometry();
+		built.accelerator.build(built);
+		SceneCache::save(CACHE_FILE, SCENE_KEY, built);
+
+		PolygonData objects = parseScene();
+		check(!SceneCache::load(CACHE_FILE, SCENE_KEY + 1, objects), "a cache saved for another scene key is stale");
+		check(objects.accelerator.instances.empty() && objects.loadedTriangles[0].normal == glm::vec3(0), "a stale cache leaves the objects untouched");
+
+		PolygonData fewerTriangles = parseScene();
+		fewerTriangles.loadedTriangles.pop_back();
+		check(!SceneCache::load(CACHE_FILE, SCENE_KEY, fewerTriangles), "a cache saved for more triangles is stale");
+
+		check(!SceneCache::load("SceneCacheTests.missing", SCENE_KEY, objects), "a missing cache");
+
+		// cut short part way through the trees
+		std::ifstream inputStream(CACHE_FILE, std::ios::binary);
+		std::vector<char> bytes((std::istreambuf_iterator<char>(inputStream)), std::istreambuf_iterator<char>());
+		inputStream.close();
+		std::ofstream outputStream(CACHE_FILE, std::ios::binary | std::ios::trunc);
+		outputStream.write(bytes.data(), bytes.size() * 3 / 4);
+		outputStream.close();
+		check(!SceneCache::load(CACHE_FILE, SCENE_KEY, objects), "a truncated cache is corrupt");
+		check(objects.accelerator.instances.empty(), "a corrupt cache leaves the objects untouched");
+	}
+}
+
+int main() {
+	testRoundTrip();
+	testRejected();
+	std::remove(CACHE_FILE);
+
+	if (failures > 0) {
+		std::printf("%d checks failed\n", failures);
+		return 1;
+	}
+	std::printf("all scene cache checks passed\n");
+	return 0;
+}
@@ -0,0 +1,115 @@
+#include <TaskGraph.h>
+#include <ThreadPool.h>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// stages are ordered by what they read and write: after the last writer of anything they touch, and writers after
+// the readers before them. stages that share nothing, or only read the same thing, run at the same time
+namespace {
+	int failures = 0;
+
+	void check(bool condition, const std::string& what) {
+		if (condition) return;
+		failures++;
+		std::printf("FAILED: %s\n", what.c_str());
+	}
+
+	// when each stage started and finished, on one clock shared by every stage
+	struct StageLog {
+		std::atomic<int> clock{ 0 };
+		std::vector<int> started;
+		std::vector<int> finished;
+
+		explicit StageLog(int stageCount) : started(stageCount, -1), finished(stageCount, -1) {}
+
+		// work that records stage and takes long enough for a stage wrongly started alongside it to show
+		std::function<void()> record(int stage) {
+			return [this, stage] {
+				started[stage] = clock++;
+				std::this_thread::sleep_for(std::chrono::milliseconds(5));
+				finished[stage] = clock++;
+			};
+		}
+
+		bool before(int first, int second) const {
+			return finished[first] >= 0 && started[second] >= 0 && finished[first] < started[second];
+		}
+	};
+
+	void testOrdering() {
+		enum { WRITE_A, READ_A, READ_A_AGAIN, WRITE_A_AFTER_READS, WRITE_B, READ_AND_WRITE_B, NO_RESOURCES, STAGE_COUNT };
+		StageLog log(STAGE_COUNT);
+		TaskGraph graph;
+		graph.add("write a", {}, { "a" }, log.record(WRITE_A));
+		graph.add("read a", { "a" }, {}, log.record(READ_A));
+		graph.add("read a again", { "a" }, {}, log.record(READ_A_AGAIN));
+		graph.add("write a after reads", {}, { "a" }, log.record(WRITE_A_AFTER_READS));
+		graph.add("write b", {}, { "b" }, log.record(WRITE_B));
+		graph.add("read and write b", { "b" }, { "b" }, log.record(READ_AND_WRITE_B));
+		graph.add("no resources", {}, {}, log.record(NO_RESOURCES));
+		graph.run();
+
+		for (int stage = 0; stage < STAGE_COUNT; stage++) check(log.finished[stage] >= 0, "stage " + std::to_string(stage) + " ran");
+		check(log.before(WRITE_A, READ_A), "a read waits for the write before it");
+		check(log.before(WRITE_A, READ_A_AGAIN), "every read waits for the write before it");
+		check(log.before(READ_A, WRITE_A_AFTER_READS) && log.before(READ_A_AGAIN, WRITE_A_AFTER_READS), "a write waits for the reads before it");
+		check(log.before(WRITE_A, WRITE_A_AFTER_READS), "a write waits for the write before it");
+		check(log.before(WRITE_B, READ_AND_WRITE_B), "a stage reading and writing waits for the last writer, and not for itself");
+
+		std::vector<std::pair<std::string, float>> timings = graph.getTimings();
+		check(timings.size() == STAGE_COUNT && timings[0].first == "write a" && timings[STAGE_COUNT - 1].first == "no resources",
+			"timings in the order the stages were added");
+	}
+
+	// each of the two stages waits until the other one has started, which only happens if they run side by side
+	void testOverlap(const std::vector<std::string>& firstReads, const std::vector<std::string>& firstWrites,
+		const std::vector<std::string>& secondReads, const std::vector<std::string>& secondWrites, const std::string& what) {
+		std::mutex mutex;
+		std::condition_variable changed;
+		int startedCount = 0;
+		bool overlapped[2] = { false, false };
+		auto meet = [&](int stage) {
+			return [&, stage] {
+				std::unique_lock<std::mutex> lock(mutex);
+				startedCount++;
+				changed.notify_all();
+				overlapped[stage] = changed.wait_for(lock, std::chrono::seconds(10), [&] { return startedCount == 2; });
+			};
+		};
+		TaskGraph graph;
+		graph.add("first", firstReads, firstWrites, meet(0));
+		graph.add("second", secondReads, secondWrites, meet(1));
+		graph.run();
+		check(overlapped[0] && overlapped[1], what);
+	}
+
+	void testClear() {
+		StageLog log(2);
+		TaskGraph graph;
+		graph.add("stale writer", {}, { "a" }, [] {});
+		graph.clear();
+		check(graph.getTimings().empty(), "clear forgets the stages");
+		graph.add("write a", {}, { "a" }, log.record(0));
+		graph.add("read a", { "a" }, {}, log.record(1));
+		graph.run();
+		check(log.before(0, 1), "stages added after a clear depend on each other");
+	}
+}
+
+int main() {
+	threadPool.resize(4);
+	for (int round = 0; round < 10; round++) testOrdering();
+	testOverlap({}, { "a" }, {}, { "b" }, "stages writing different resources overlap");
+	testOverlap({ "a" }, { "b" }, { "a" }, { "c" }, "stages only sharing a read overlap");
+	testOverlap({}, {}, {}, {}, "stages without resources overlap");
+	testClear();
+
+	if (failures > 0) {
+		std::printf("%d checks failed\n", failures);
+		return 1;
+	}
+	std::printf("all task graph checks passed\n");
+	return 0;
+}
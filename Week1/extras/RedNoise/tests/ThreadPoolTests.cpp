@@ -0,0 +1,137 @@
+#include <ThreadPool.h>
+#include <chrono>
+#include <cstdio>
+#include <set>
+#include <string>
+#include <vector>
+
+// every index of a pass runs exactly once however the passes nest, and tasks a busy worker queued on its own deque
+// are stolen by the others instead of waiting for it
+namespace {
+	int failures = 0;
+
+	void check(bool condition, const std::string& what) {
+		if (condition) return;
+		failures++;
+		std::printf("FAILED: %s\n", what.c_str());
+	}
+
+	// counts how often every index ran, for a pass of count indices
+	struct RunCounts {
+		std::vector<std::atomic<int>> runs;
+
+		explicit RunCounts(int count) : runs(count) {
+			for (auto& run : runs) run = 0;
+		}
+
+		bool eachOnce() const {
+			for (const auto& run : runs) {
+				if (run != 1) return false;
+			}
+			return true;
+		}
+	};
+
+	void testParallelFor(ThreadPool& pool, const std::string& where) {
+		for (int count : { 0, 1, 7, 1000 }) {
+			RunCounts counts(count);
+			pool.parallelFor(count, [&](int i) { counts.runs[i]++; });
+			check(counts.eachOnce(), "every index of " + std::to_string(count) + " once, " + where);
+		}
+	}
+
+	void testNested(ThreadPool& pool, const std::string& where) {
+		const int outer = 37;
+		const int inner = 11;
+		for (int round = 0; round < 20; round++) {
+			RunCounts counts(outer * inner);
+			// the inner passes run on workers, which only help with their own indices while they wait
+			pool.parallelFor(outer, [&](int i) {
+				pool.parallelFor(inner, [&](int j) { counts.runs[i * inner + j]++; });
+			});
+			check(counts.eachOnce(), "every index of nested passes once, round " + std::to_string(round) + ", " + where);
+		}
+	}
+
+	// tasks queued from a worker go on its own deque. the worker then blocks until they have all run, which only
+	// happens if the other workers steal them
+	void testStealing(ThreadPool& pool) {
+		const int taskCount = 64;
+		struct Shared {
+			std::mutex mutex;
+			std::condition_variable changed;
+			int finished = 0;
+			std::set<std::thread::id> ranOn;
+			std::thread::id blockedWorker;
+			bool stolenInTime = false;
+			bool done = false;
+		};
+		auto shared = std::make_shared<Shared>();
+		pool.submit([shared, &pool] {
+			{
+				std::lock_guard<std::mutex> lock(shared->mutex);
+				shared->blockedWorker = std::this_thread::get_id();
+			}
+			for (int task = 0; task < taskCount; task++) {
+				pool.submit([shared] {
+					std::lock_guard<std::mutex> lock(shared->mutex);
+					shared->ranOn.insert(std::this_thread::get_id());
+					shared->finished++;
+					shared->changed.notify_all();
+				});
+			}
+			std::unique_lock<std::mutex> lock(shared->mutex);
+			shared->stolenInTime = shared->changed.wait_for(lock, std::chrono::seconds(10), [&] { return shared->finished == taskCount; });
+			shared->done = true;
+			shared->changed.notify_all();
+		});
+		std::unique_lock<std::mutex> lock(shared->mutex);
+		shared->changed.wait(lock, [&] { return shared->done; });
+		check(shared->stolenInTime, "tasks queued by a blocked worker are stolen by the others");
+		check(shared->ranOn.count(shared->blockedWorker) == 0, "the blocked worker ran none of its own tasks");
+	}
+
+	// like the task graph, pool tasks queuing passes of their own
+	void testSubmitFromTasks(ThreadPool& pool, const std::string& where) {
+		const int taskCount = 50;
+		std::mutex mutex;
+		std::condition_variable changed;
+		int finished = 0;
+		RunCounts counts(taskCount * 5);
+		for (int task = 0; task < taskCount; task++) {
+			pool.submit([&, task] {
+				pool.parallelFor(5, [&](int i) { counts.runs[task * 5 + i]++; });
+				std::lock_guard<std::mutex> lock(mutex);
+				finished++;
+				changed.notify_all();
+			});
+		}
+		std::unique_lock<std::mutex> lock(mutex);
+		changed.wait(lock, [&] { return finished == taskCount; });
+		check(counts.eachOnce(), "every index of passes queued from tasks once, " + where);
+	}
+}
+
+int main() {
+	for (int workers : { 1, 2, 4, 8 }) {
+		ThreadPool pool(workers);
+		std::string where = std::to_string(workers) + " workers";
+		check(pool.getWorkerCount() == workers, "worker count, " + where);
+		testParallelFor(pool, where);
+		testNested(pool, where);
+		testSubmitFromTasks(pool, where);
+		if (workers > 1) testStealing(pool);
+	}
+
+	ThreadPool pool(2);
+	pool.resize(5);
+	check(pool.getWorkerCount() == 5, "worker count after a resize");
+	testParallelFor(pool, "after a resize");
+
+	if (failures > 0) {
+		std::printf("%d checks failed\n", failures);
+		return 1;
+	}
+	std::printf("all thread pool checks passed\n");
+	return 0;
+}
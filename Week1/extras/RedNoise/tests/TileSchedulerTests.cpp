@@ -0,0 +1,95 @@
+#include <TileScheduler.h>
+#include <ThreadPool.h>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// the tiles of a frame cover every pixel once, and a frame whose epoch goes stale stops handing out tiles: each
+// worker finishes at most the tile it was on, and run reports the frame as cut short
+namespace {
+	const int WIDTH = 100;
+	const int HEIGHT = 70; // neither a multiple of the tile size
+	int failures = 0;
+
+	void check(bool condition, const std::string& what) {
+		if (condition) return;
+		failures++;
+		std::printf("FAILED: %s\n", what.c_str());
+	}
+
+	struct Coverage {
+		std::vector<std::atomic<int>> pixels;
+		std::atomic<int> tiles{ 0 };
+
+		Coverage() : pixels(WIDTH * HEIGHT) {
+			for (auto& pixel : pixels) pixel = 0;
+		}
+
+		void add(glm::ivec2 tileMin, glm::ivec2 tileMax) {
+			tiles++;
+			for (int y = tileMin.y; y < tileMax.y; y++) {
+				for (int x = tileMin.x; x < tileMax.x; x++) pixels[y * WIDTH + x]++;
+			}
+		}
+
+		bool eachOnce() const {
+			for (const auto& pixel : pixels) {
+				if (pixel != 1) return false;
+			}
+			return true;
+		}
+	};
+
+	void testWholeFrame(TileScheduler& scheduler, const std::string& where) {
+		std::atomic<unsigned> epoch(3);
+		for (Cancellation cancellation : { Cancellation{ nullptr, 0 }, Cancellation{ &epoch, 3 } }) {
+			Coverage coverage;
+			bool completed = scheduler.run([&](glm::ivec2 tileMin, glm::ivec2 tileMax) { coverage.add(tileMin, tileMax); }, cancellation);
+			check(completed, "a frame nothing cancels completes, " + where);
+			check(coverage.tiles == scheduler.getTileCount() && coverage.eachOnce(), "every pixel traced once, " + where);
+		}
+	}
+
+	void testCancelled(TileScheduler& scheduler, const std::string& where) {
+		// stale before the first tile
+		std::atomic<unsigned> epoch(1);
+		Coverage coverage;
+		bool completed = scheduler.run([&](glm::ivec2 tileMin, glm::ivec2 tileMax) { coverage.add(tileMin, tileMax); }, { &epoch, 0 });
+		check(!completed && coverage.tiles == 0, "a frame already stale traces no tiles, " + where);
+
+		// input arriving part way through, while the fifth tile traces
+		epoch = 0;
+		std::atomic<int> tilesStarted(0);
+		std::atomic<int> tilesAfterInput(0);
+		Coverage partial;
+		completed = scheduler.run([&](glm::ivec2 tileMin, glm::ivec2 tileMax) {
+			if (epoch != 0) tilesAfterInput++;
+			if (tilesStarted++ == 4) epoch++;
+			partial.add(tileMin, tileMax);
+		}, { &epoch, 0 });
+		check(!completed, "a frame whose epoch moved is reported cut short, " + where);
+		check(partial.tiles < scheduler.getTileCount(), "a cancelled frame stops handing out tiles, " + where);
+		// every other worker may have been part way into a tile when the epoch moved, none starts another
+		check(tilesAfterInput < threadPool.getWorkerCount(), "workers stop at their next tile, " + where);
+	}
+}
+
+int main() {
+	for (int workers : { 1, 4 }) {
+		threadPool.resize(workers);
+		TileScheduler scheduler(WIDTH, HEIGHT);
+		std::string where = std::to_string(workers) + " workers";
+		testWholeFrame(scheduler, where);
+		testCancelled(scheduler, where);
+		scheduler.orderByCost = true;
+		testWholeFrame(scheduler, where + ", ordered by cost");
+		testCancelled(scheduler, where + ", ordered by cost");
+	}
+
+	if (failures > 0) {
+		std::printf("%d checks failed\n", failures);
+		return 1;
+	}
+	std::printf("all tile scheduler checks passed\n");
+	return 0;
+}